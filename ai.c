@@ -0,0 +1,291 @@
+// SPDX-License-Identifier: GPL-3.0-only
+// Copyright © 2024  Mario D'Andrea https://ormai.me
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ai.h"
+#include "map.h"
+#include "snake.h"
+
+/// Number of entries in the transposition table, it must be a power of two.
+#define TABLE_SIZE (1 << 16)
+/// Salts of the keys mixed in the hash of the snake to identify a position.
+#define APPLE_SALT 0x632be59bd9b4e019ULL
+#define GROWING_KEY 0x8cb92ba72f3d8dd7ULL
+/// Apple of a search where it has been eaten, the same as a map with no room
+/// for the apple. It is a corner of the border, where no apple can be.
+#define NO_APPLE 0
+
+/// Eating the apple is worth more than any amount of space, and dying is worse
+/// than anything else. Both are scaled by the ticks left in the search, so that
+/// eating sooner and dying later are preferred.
+#define EAT_SCORE 1'000'000
+#define DEATH_SCORE (-100'000'000)
+/// Score of a position where the snake cannot reach as many cells as it is
+/// long, it will probably die there.
+#define TRAPPED_SCORE (-10'000'000)
+/// Score lost for each step to the apple. A step towards the apple must count
+/// more than one away from a wall, or the two cancel out next to walls and the
+/// snake circles around.
+#define APPLE_DISTANCE_SCORE 2
+
+/// A position already scored by the search.
+struct entry {
+  uint64_t key;
+  /// How many ticks the search looked ahead from the position.
+  int depth;
+  int score;
+};
+
+struct ai {
+  /// The snake at each tick of the search. The bodies are allocated once, so
+  /// that looking one tick further is a copy and never an allocation.
+  struct snake plies[AI_MAX_DEPTH + 1];
+  struct entry *table;
+  /// Cells of the map taken or reached during a flood fill hold `stamp`, so
+  /// that the marks need not be cleared between flood fills.
+  unsigned *marks;
+  unsigned stamp;
+  uint32_t *queue;
+  /// Length of the shortest path from each cell to `apple`, around the walls.
+  int *to_apple;
+  uint32_t apple;
+  long long deadline;
+  unsigned long nodes;
+  bool out_of_time;
+};
+
+/// Returns the current time in nanoseconds.
+[[nodiscard]] static long long time_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1'000'000'000LL + ts.tv_nsec;
+}
+
+struct ai *ai_create(const struct map *map) {
+  struct ai *ai = calloc(1, sizeof(struct ai));
+  for (int i = 0; i <= AI_MAX_DEPTH; ++i) {
+    ai->plies[i].body = malloc(sizeof(uint32_t[map->area + 1]));
+  }
+  const size_t cells = (size_t)map->stride * (map->height + 3);
+  ai->table = calloc(TABLE_SIZE, sizeof(struct entry));
+  ai->marks = calloc(cells, sizeof(unsigned));
+  ai->queue = malloc(sizeof(uint32_t[cells]));
+  ai->to_apple = malloc(sizeof(int[cells]));
+  ai->apple = NO_APPLE;
+  return ai;
+}
+
+void ai_destroy(struct ai *ai) {
+  if (ai != nullptr) {
+    for (int i = 0; i <= AI_MAX_DEPTH; ++i) {
+      free(ai->plies[i].body);
+    }
+    free(ai->table);
+    free(ai->marks);
+    free(ai->queue);
+    free(ai->to_apple);
+    free(ai);
+    ai = nullptr;
+  }
+}
+
+/// Copies `source` into `destination` without touching the body buffer of the
+/// latter.
+static void clone(struct snake *destination, const struct snake *source) {
+  uint32_t *body = destination->body;
+  *destination = *source;
+  destination->body = body;
+  memcpy(body, source->body, sizeof(uint32_t[source->length]));
+}
+
+/// Whether moving towards `direction` means turning back, which the game does
+/// not allow.
+static bool reverses(const struct snake *snake,
+                     const enum direction direction) {
+  return snake->length > 1 &&
+         direction == (snake->direction + 2) % (LEFT + 1);
+}
+
+/// Advances the snake at `ply` towards `direction` into the next ply. Returns
+/// whether it survives. If it eats the apple, the apple becomes `NO_APPLE`.
+static bool step(struct ai *ai, const struct map *map, const int ply,
+                 const enum direction direction, uint32_t *apple, bool *ate) {
+  struct snake *snake = &ai->plies[ply + 1];
+  clone(snake, &ai->plies[ply]);
+  snake->direction = direction;
+  advance(snake);
+  if (!is_inside(map, snake) || self_collision(snake)) {
+    return false;
+  }
+  if ((*ate = snake->head == *apple)) {
+    snake->growing = true;
+    ++snake->length;
+    *apple = NO_APPLE;
+  }
+  return true;
+}
+
+/// Measures the distance of every cell from the apple, going around the walls
+/// but through the snake, that moves out of the way in the meantime.
+static void measure_apple_distance(struct ai *ai, const struct map *map,
+                                   const int32_t steps[]) {
+  const int unreachable = map->stride * (map->height + 3);
+  for (int i = 0; i < unreachable; ++i) {
+    ai->to_apple[i] = unreachable;
+  }
+
+  size_t first = 0, last = 0;
+  ai->apple = map->apple;
+  ai->to_apple[ai->apple] = 0;
+  ai->queue[last++] = ai->apple;
+  while (first < last) {
+    const uint32_t cell = ai->queue[first++];
+    for (int i = 0; i < 4; ++i) {
+      const uint32_t n = cell + steps[i];
+      if (map->grid[n] != WALL && ai->to_apple[n] == unreachable) {
+        ai->to_apple[n] = ai->to_apple[cell] + 1;
+        ai->queue[last++] = n;
+      }
+    }
+  }
+}
+
+/// Scores a position by the cells the snake can still reach and by how far
+/// the apple is.
+static int evaluate(struct ai *ai, const struct map *map,
+                    const struct snake *snake, const uint32_t apple) {
+  if (++ai->stamp == 0) {
+    memset(ai->marks, 0, sizeof(unsigned[map->stride * (map->height + 3)]));
+    ai->stamp = 1;
+  }
+  // The tail moves out of the way as the snake advances, unless it grows. A
+  // growing snake is one cell longer than its body until it advances.
+  const size_t tail = snake->growing ? 0 : 1,
+               end = snake->growing ? snake->length - 1 : snake->length;
+  for (size_t i = tail; i < end; ++i) {
+    ai->marks[snake->body[i]] = ai->stamp;
+  }
+
+  // Reaching twice as many cells as the snake is long is as good as it gets,
+  // there is no need to fill the whole map.
+  const size_t limit = snake->length * 2 + 1;
+  size_t reached = 0, first = 0, last = 0;
+  ai->queue[last++] = snake->head;
+  while (first < last && reached < limit) {
+    const uint32_t cell = ai->queue[first++];
+    for (int i = 0; i < 4; ++i) {
+      const uint32_t n = cell + snake->steps[i];
+      if (map->grid[n] != WALL && ai->marks[n] != ai->stamp) {
+        ai->marks[n] = ai->stamp;
+        ai->queue[last++] = n;
+        ++reached;
+      }
+    }
+  }
+
+  // Staying away from the walls leaves more ways out
+  const int distance = map->distance[snake->head];
+  int score = (int)reached * 16 + (distance < 4 ? distance : 4);
+  if (reached < snake->length) {
+    score += TRAPPED_SCORE;
+  }
+  if (apple != NO_APPLE) {
+    score -= APPLE_DISTANCE_SCORE * ai->to_apple[snake->head];
+  }
+  return score;
+}
+
+/// Returns the score of the best position the snake at `ply` can reach in
+/// `depth` ticks.
+static int search(struct ai *ai, const struct map *map, const int ply,
+                  const int depth, const uint32_t apple) {
+  const struct snake *snake = &ai->plies[ply];
+  if (depth == 0) {
+    return evaluate(ai, map, snake, apple);
+  }
+  if ((++ai->nodes & 63) == 0 && time_ns() > ai->deadline) {
+    ai->out_of_time = true;
+  }
+  if (ai->out_of_time) {
+    return 0;
+  }
+
+  const uint64_t key = snake->hash ^ zobrist_key(apple, APPLE_SALT) ^
+                       (snake->growing ? GROWING_KEY : 0);
+  struct entry *entry = &ai->table[key & (TABLE_SIZE - 1)];
+  // Scores add up along the way, so a score from a deeper search is on another
+  // scale than those of its siblings. Reusing it made the snake chase its own
+  // cached positions and go around in loops.
+  if (entry->key == key && entry->depth == depth) {
+    return entry->score;
+  }
+
+  int best = INT_MIN;
+  for (enum direction direction = UP; direction <= LEFT; ++direction) {
+    if (reverses(snake, direction)) {
+      continue;
+    }
+    uint32_t next_apple = apple;
+    bool ate = false;
+    const int score =
+        step(ai, map, ply, direction, &next_apple, &ate)
+            ? (ate ? EAT_SCORE * depth : 0) +
+                  search(ai, map, ply + 1, depth - 1, next_apple)
+            : DEATH_SCORE * depth;
+    if (score > best) {
+      best = score;
+    }
+  }
+
+  if (!ai->out_of_time) {
+    *entry = (struct entry){key, depth, best};
+  }
+  return best;
+}
+
+enum direction ai_next_direction(struct ai *ai, const struct map *map,
+                                 const struct snake *snake,
+                                 const long long budget) {
+  ai->deadline = time_ns() + budget;
+  ai->out_of_time = false;
+  clone(&ai->plies[0], snake);
+  if (map->apple != NO_APPLE && ai->apple != map->apple) {
+    measure_apple_distance(ai, map, snake->steps);
+  }
+
+  // Look further ahead until the time runs out, keeping the choice of the
+  // deepest search that completed.
+  enum direction choice = snake->direction;
+  for (int depth = 1; depth <= AI_MAX_DEPTH && !ai->out_of_time; ++depth) {
+    int best = INT_MIN;
+    enum direction best_direction = snake->direction;
+    for (enum direction direction = UP; direction <= LEFT; ++direction) {
+      if (reverses(snake, direction)) {
+        continue;
+      }
+      uint32_t apple = map->apple;
+      bool ate = false;
+      const int score = step(ai, map, 0, direction, &apple, &ate)
+                            ? (ate ? EAT_SCORE * depth : 0) +
+                                  search(ai, map, 1, depth - 1, apple)
+                            : DEATH_SCORE * depth;
+      if (score > best) {
+        best = score;
+        best_direction = direction;
+      }
+    }
+    if (!ai->out_of_time) {
+      choice = best_direction;
+    }
+    if (best < TRAPPED_SCORE) { // Every way leads to death
+      break;
+    }
+  }
+  return choice;
+}
@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: GPL-3.0-only
+// Copyright © 2024  Mario D'Andrea https://ormai.me
+
+// An autopilot that looks a few ticks ahead. It simulates the moves of the
+// snake on copies of it, scores the positions it reaches by the space left to
+// move in and the distance to the apple, and picks the move leading to the best
+// one. Positions reached in more than one way are looked up in a transposition
+// table keyed by the Zobrist hash of the snake.
+
+#ifndef AI_H
+#define AI_H
+
+#include "map.h"
+#include "snake.h"
+
+/// How many ticks the autopilot looks ahead at most.
+#define AI_MAX_DEPTH 12
+
+struct ai;
+
+/// Creates an autopilot for snakes on `map`. This function allocates all the
+/// memory needed by the search up front.
+[[nodiscard]] struct ai *ai_create(const struct map *map);
+
+/// Destroys an autopilot created with `ai_create`.
+void ai_destroy(struct ai *ai);
+
+/// Returns the direction the snake should take before it advances. The search
+/// goes deeper until it runs out of the `budget`, in nanoseconds.
+[[nodiscard]] enum direction ai_next_direction(struct ai *ai,
+                                               const struct map *map,
+                                               const struct snake *snake,
+                                               const long long budget);
+
+#endif // AI_H
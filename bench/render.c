@@ -0,0 +1,397 @@
+// SPDX-License-Identifier: GPL-3.0-only
+// Copyright © 2024  Mario D'Andrea https://ormai.me
+
+// Measures the output of the renderer. The game draws to a pseudo terminal, as
+// it would to a real one, for a few terminal sizes and both render modes. A
+// seeded game is played by a greedy driver, so every run draws the same
+// frames. For each drawing function the bytes and the `write` calls that reach
+// the terminal are counted, along with the time spent encoding the frames.
+//
+// The report goes to the standard output as JSON. Each function gets the
+// average and the largest call, and a histogram of the bytes of its calls: how
+// many sent fewer than each power of two, and at least the one before. The
+// largest call is checked against the budgets in the file given as the first
+// argument, one line for each scenario and function, and the run fails if any
+// is over budget:
+//
+//   80x24-full-block draw_walls 1700
+
+#define _XOPEN_SOURCE 600
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <threads.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../map.h"
+#include "../snake.h"
+#include "../term.h"
+#include "../window.h"
+
+#define SEED 1
+/// Ticks played in each scenario.
+#define TICKS 600
+#define MAX_BUDGETS 128
+/// Buckets of the histograms, the last one is for calls of 32 KiB or more.
+#define BUCKETS 16
+
+enum phase {
+  DRAW_WALLS,
+  REDRAW_SNAKE,
+  UPDATE_SCORE,
+  WELCOME_DIALOG,
+  OVER_DIALOG,
+  WIN_DIALOG
+};
+
+static const char *phase_names[] = {
+    [DRAW_WALLS] = "draw_walls",         [REDRAW_SNAKE] = "redraw_snake",
+    [UPDATE_SCORE] = "update_score",     [WELCOME_DIALOG] = "welcome_dialog",
+    [OVER_DIALOG] = "over_dialog",       [WIN_DIALOG] = "win_dialog"};
+
+/// What a drawing function sent to the terminal, over all of its calls.
+struct measure {
+  unsigned calls;
+  uint64_t bytes;
+  uint64_t writes;
+  long long encode_ns;
+  /// The most that a single call took.
+  uint64_t max_bytes;
+  uint64_t max_writes;
+  long long max_encode_ns;
+  /// Calls that sent fewer than `2 << i` bytes, and at least `1 << i`.
+  unsigned histogram[BUCKETS];
+};
+
+struct scenario {
+  unsigned short columns, rows;
+  enum render_mode mode;
+};
+
+static const struct scenario scenarios[] = {
+    {80, 24, FULL_BLOCK},  {80, 24, HALF_BLOCK},  {120, 40, FULL_BLOCK},
+    {120, 40, HALF_BLOCK}, {240, 70, FULL_BLOCK}, {240, 70, HALF_BLOCK}};
+
+struct budget {
+  char scenario[32];
+  char phase[32];
+  uint64_t bytes;
+};
+
+static struct budget budgets[MAX_BUDGETS];
+static size_t budget_count = 0;
+
+/// Master side of the pseudo terminal.
+static int master = -1;
+/// Stats and time at the start of the current measure.
+static struct term_stats before;
+static long long started;
+
+[[nodiscard]] static long long time_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1'000'000'000LL + ts.tv_nsec;
+}
+
+/// Reads the pseudo terminal like a terminal emulator would, until it closes.
+static int consume(void *) {
+  char buffer[1 << 16];
+  while (read(master, buffer, sizeof(buffer)) > 0) {
+  }
+  return 0;
+}
+
+/// Starts measuring a call, once everything drawn before it is written.
+static void start(void) {
+  drain();
+  before = get_term_stats();
+  started = time_ns();
+}
+
+/// Ends the measure of a call. The encode time stops before the output is
+/// written. The dialogs send their frame before waiting for a key, so theirs
+/// also includes handing it to the render thread.
+static void stop(struct measure *measure) {
+  const long long encode_ns = time_ns() - started;
+  drain();
+  const struct term_stats after = get_term_stats();
+  const uint64_t bytes = after.bytes - before.bytes,
+                 writes = after.writes - before.writes;
+
+  ++measure->calls;
+  measure->bytes += bytes;
+  measure->writes += writes;
+  measure->encode_ns += encode_ns;
+  if (bytes > measure->max_bytes) {
+    measure->max_bytes = bytes;
+  }
+  if (writes > measure->max_writes) {
+    measure->max_writes = writes;
+  }
+  if (encode_ns > measure->max_encode_ns) {
+    measure->max_encode_ns = encode_ns;
+  }
+  int bucket = 0;
+  while (bucket < BUCKETS - 1 && bytes >> (bucket + 1) != 0) {
+    ++bucket;
+  }
+  ++measure->histogram[bucket];
+}
+
+/// Queues a key for the next dialog to read, so that it returns right away.
+static void press(const char key) {
+  if (write(master, &key, 1) != 1) {
+    perror("write");
+  }
+}
+
+/// Moves toward the apple without hitting anything, when it can.
+static enum direction steer(const struct map *map, const struct snake *snake) {
+  const struct point apple = cell_point(map, map->apple);
+  enum direction best = snake->direction;
+  int best_distance = INT_MAX;
+  for (enum direction direction = UP; direction <= LEFT; ++direction) {
+    if (snake->length > 1 && direction == (snake->direction + 2) % (LEFT + 1)) {
+      continue;
+    }
+    const uint32_t next = snake->head + snake->steps[direction];
+    if (map->grid[next] == WALL || map->grid[next] == BODY) {
+      continue;
+    }
+    const struct point p = cell_point(map, next);
+    const int distance = abs(p.x - apple.x) + abs(p.y - apple.y);
+    if (distance < best_distance) {
+      best_distance = distance;
+      best = direction;
+    }
+  }
+  return best;
+}
+
+/// Starts a game like `new_game` in main.c does, measuring the walls.
+static void new_game(struct map **map, struct snake **snake,
+                     const enum render_mode mode, struct measure *measures) {
+  map_destroy(*map);
+  *map = map_create(mode, nullptr);
+  snake_destroy(*snake);
+  *snake = snake_create((*map)->spawn, (*map)->area, (*map)->stride);
+  set_cell(*map, (*snake)->head, BODY);
+
+  erase();
+  start();
+  draw_walls(*map);
+  stop(&measures[DRAW_WALLS]);
+  spawn_apple(*map);
+  start();
+  update_score(*map, (*snake)->length);
+  stop(&measures[UPDATE_SCORE]);
+  set_color(BRIGHT_GREEN);
+  draw_point(*map, (*snake)->head);
+}
+
+/// Plays a scenario and fills in the measures of each drawing function.
+static void play(const struct scenario *scenario, struct measure *measures) {
+  const struct winsize ws = {.ws_row = scenario->rows,
+                             .ws_col = scenario->columns};
+  ioctl(STDOUT_FILENO, TIOCSWINSZ, &ws);
+  srand(SEED);
+  term_init();
+
+  press('q');
+  start();
+  if (!welcome_dialog(&(enum difficulty){INCREMENTAL})) {
+    fprintf(stderr, "render: the welcome dialog did not quit\n");
+  }
+  stop(&measures[WELCOME_DIALOG]);
+
+  struct map *map = nullptr;
+  struct snake *snake = nullptr;
+  new_game(&map, &snake, scenario->mode, measures);
+  for (int tick = 0; tick < TICKS; ++tick) {
+    if (snake->head == map->apple) {
+      snake->growing = true;
+      ++snake->length;
+      start();
+      update_score(map, snake->length);
+      stop(&measures[UPDATE_SCORE]);
+      spawn_apple(map);
+    }
+    change_direction(snake, steer(map, snake));
+    advance(snake);
+    if (!is_inside(map, snake) || self_collision(snake)) {
+      new_game(&map, &snake, scenario->mode, measures);
+      continue;
+    }
+    start();
+    redraw_snake(map, snake);
+    stop(&measures[REDRAW_SNAKE]);
+    refresh();
+  }
+
+  enum difficulty difficulty = INCREMENTAL;
+  press('q');
+  start();
+  if (!over_dialog(map, &difficulty, snake->length)) {
+    fprintf(stderr, "render: the game over dialog did not quit\n");
+  }
+  stop(&measures[OVER_DIALOG]);
+  press('q');
+  start();
+  if (!win_dialog(map, &difficulty, snake->length)) {
+    fprintf(stderr, "render: the win dialog did not quit\n");
+  }
+  stop(&measures[WIN_DIALOG]);
+
+  snake_destroy(snake);
+  map_destroy(map);
+  term_finalize();
+}
+
+/// Loads the budgets, ignoring empty lines and comments starting with `#`.
+static bool load_budgets(const char *path) {
+  FILE *file = fopen(path, "r");
+  if (file == nullptr) {
+    return false;
+  }
+  char line[128];
+  while (fgets(line, sizeof(line), file) != nullptr &&
+         budget_count < MAX_BUDGETS) {
+    struct budget *budget = &budgets[budget_count];
+    if (sscanf(line, "%31s %31s %" SCNu64, budget->scenario, budget->phase,
+               &budget->bytes) == 3 &&
+        budget->scenario[0] != '#') {
+      ++budget_count;
+    }
+  }
+  fclose(file);
+  return true;
+}
+
+/// Returns the budget of bytes for each call, or `nullptr` if there is none.
+static const struct budget *find_budget(const char *scenario,
+                                        const char *phase) {
+  for (size_t i = 0; i < budget_count; ++i) {
+    if (strcmp(budgets[i].scenario, scenario) == 0 &&
+        strcmp(budgets[i].phase, phase) == 0) {
+      return &budgets[i];
+    }
+  }
+  return nullptr;
+}
+
+/// Writes the measures of a scenario to the report. Returns `false` if any of
+/// them is over budget.
+static bool report(FILE *out, const struct scenario *scenario,
+                   const struct measure *measures, const bool last) {
+  char name[32];
+  snprintf(name, sizeof(name), "%ux%u-%s", scenario->columns, scenario->rows,
+           scenario->mode == HALF_BLOCK ? "half-block" : "full-block");
+  fprintf(out, "    {\"name\": \"%s\", \"columns\": %u, \"rows\": %u,\n", name,
+          scenario->columns, scenario->rows);
+  fprintf(out, "     \"phases\": {\n");
+
+  bool within = true;
+  for (enum phase phase = DRAW_WALLS; phase <= WIN_DIALOG; ++phase) {
+    const struct measure *m = &measures[phase];
+    const unsigned calls = m->calls > 0 ? m->calls : 1;
+    const struct budget *budget = find_budget(name, phase_names[phase]);
+    const bool ok = budget == nullptr || m->max_bytes <= budget->bytes;
+    within = within && ok;
+    if (!ok) {
+      fprintf(stderr, "render: %s %s writes up to %" PRIu64
+              " bytes, the budget is %" PRIu64 "\n",
+              name, phase_names[phase], m->max_bytes, budget->bytes);
+    }
+
+    fprintf(out,
+            "       \"%s\": {\"calls\": %u, \"bytes_per_call\": %.1f, "
+            "\"max_bytes\": %" PRIu64 ", \"writes_per_call\": %.2f, "
+            "\"max_writes\": %" PRIu64 ", \"encode_ns_per_call\": %lld, "
+            "\"max_encode_ns\": %lld, ",
+            phase_names[phase], m->calls, (double)m->bytes / calls,
+            m->max_bytes, (double)m->writes / calls, m->max_writes,
+            m->encode_ns / calls, m->max_encode_ns);
+    fprintf(out, "\"bytes_histogram\": {");
+    bool first = true;
+    for (int bucket = 0; bucket < BUCKETS; ++bucket) {
+      if (m->histogram[bucket] > 0) {
+        const bool open = bucket == BUCKETS - 1;
+        fprintf(out, "%s\"%s%lu\": %u", first ? "" : ", ", open ? ">=" : "<",
+                open ? 1UL << bucket : 2UL << bucket, m->histogram[bucket]);
+        first = false;
+      }
+    }
+    fprintf(out, "}, ");
+    if (budget != nullptr) {
+      fprintf(out, "\"budget\": %" PRIu64 ", ", budget->bytes);
+    } else {
+      fprintf(out, "\"budget\": null, ");
+    }
+    fprintf(out, "\"ok\": %s}%s\n", ok ? "true" : "false",
+            phase < WIN_DIALOG ? "," : "");
+  }
+  fprintf(out, "     }}%s\n", last ? "" : ",");
+  return within;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s BUDGETS\n", argv[0]);
+    return 2;
+  }
+  if (!load_budgets(argv[1])) {
+    fprintf(stderr, "%s: cannot read %s\n", argv[0], argv[1]);
+    return 2;
+  }
+
+  // The game draws to the pseudo terminal, the report goes where stdout was
+  if ((master = posix_openpt(O_RDWR | O_NOCTTY)) == -1 ||
+      grantpt(master) == -1 || unlockpt(master) == -1) {
+    perror("posix_openpt");
+    return 2;
+  }
+  const int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+  if (slave == -1) {
+    perror("open");
+    return 2;
+  }
+  FILE *out = fdopen(dup(STDOUT_FILENO), "w");
+  const int saved_input = dup(STDIN_FILENO);
+  dup2(slave, STDIN_FILENO);
+  dup2(slave, STDOUT_FILENO);
+  close(slave);
+  thrd_t consumer;
+  thrd_create(&consumer, consume, nullptr);
+  setlocale(LC_ALL, "");
+
+  const size_t count = sizeof(scenarios) / sizeof(scenarios[0]);
+  struct measure measures[count][WIN_DIALOG + 1];
+  memset(measures, 0, sizeof(measures));
+  for (size_t i = 0; i < count; ++i) {
+    play(&scenarios[i], measures[i]);
+  }
+
+  // Hang up the pseudo terminal, so that the consumer stops
+  dup2(saved_input, STDIN_FILENO);
+  dup2(fileno(out), STDOUT_FILENO);
+  close(saved_input);
+  thrd_join(consumer, nullptr);
+  close(master);
+
+  fprintf(out, "{\"seed\": %d, \"ticks\": %d, \"scenarios\": [\n", SEED,
+          TICKS);
+  bool within = true;
+  for (size_t i = 0; i < count; ++i) {
+    within = report(out, &scenarios[i], measures[i], i + 1 == count) && within;
+  }
+  fprintf(out, "]}\n");
+  fclose(out);
+  return within ? 0 : 1;
+}
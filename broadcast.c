@@ -0,0 +1,522 @@
+// SPDX-License-Identifier: GPL-3.0-only
+// Copyright © 2024  Mario D'Andrea https://ormai.me
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "broadcast.h"
+#include "level.h"
+#include "map.h"
+#include "snake.h"
+#include "term.h"
+#include "window.h"
+
+/// "SNAKE", followed by the version of the shared memory layout.
+#define BROADCAST_MAGIC 0x534e414b45000103ULL
+/// Ticks kept in the ring buffer, it must be a power of two.
+#define EVENTS 256
+/// Ticks between two snapshots. It must be well below `EVENTS`, so that the
+/// ticks after the last snapshot are still in the ring buffer.
+#define SNAPSHOT_INTERVAL 64
+
+/// What changed in a tick.
+struct change {
+  uint32_t game;
+  uint32_t length;
+  uint32_t apple;
+  enum direction direction;
+  /// Whether the snake grew while advancing.
+  bool grew;
+};
+
+struct event {
+  /// `2 * tick + 1` while the change is being written, `2 * tick + 2` after.
+  _Atomic uint64_t sequence;
+  struct change change;
+};
+
+struct snapshot {
+  /// Last tick included in the snapshot.
+  uint64_t tick;
+  uint32_t game;
+  uint32_t length;
+  int width;
+  int height;
+  uint32_t apple;
+  enum direction direction;
+};
+
+/// Layout of the shared memory.
+struct broadcast {
+  /// `0` until the game has set up the shared memory.
+  uint64_t magic;
+  /// Process of the game, to tell a broadcast left behind by a crash.
+  pid_t owner;
+  /// Size of the shared memory. It grows when a game has a bigger map.
+  _Atomic uint64_t size;
+  /// Last tick published.
+  _Atomic uint64_t tick;
+  /// Whether the game is still going.
+  atomic_bool live;
+  /// Sequence lock of the snapshot, odd while it is being written.
+  _Atomic uint64_t sequence;
+  struct event events[EVENTS];
+  struct snapshot snapshot;
+  /// Whether each cell of the map in the snapshot is a wall, followed by the
+  /// body of the snake.
+  unsigned char data[];
+};
+
+/// State of the game side of the broadcast.
+static struct broadcast *published = nullptr;
+static size_t published_size = 0;
+static int published_fd = -1;
+static uint64_t last_tick = 0;
+static uint32_t game = 0;
+
+/// Name of the shared memory, one for each user.
+static void shared_name(char *name, const size_t size) {
+  snprintf(name, size, "/snake-%u", (unsigned)getuid());
+}
+
+/// Bytes taken by the walls in the shared memory. The body that follows stays
+/// aligned.
+static size_t walls_size(const int width, const int height) {
+  const size_t cells = (size_t)(width + 1) * (height + 1);
+  return (cells + sizeof(uint32_t) - 1) & ~(sizeof(uint32_t) - 1);
+}
+
+static void write_snapshot(const struct map *map, const struct snake *snake,
+                           const bool walls) {
+  const uint64_t sequence =
+      atomic_load_explicit(&published->sequence, memory_order_relaxed);
+  atomic_store_explicit(&published->sequence, sequence + 1,
+                        memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+
+  published->snapshot = (struct snapshot){.tick = last_tick,
+                                       .game = game,
+                                       .length = snake->length,
+                                       .width = map->width,
+                                       .height = map->height,
+                                       .apple = map->apple,
+                                       .direction = snake->direction};
+  if (walls) { // They only change with a new game
+    bool *cells = (bool *)published->data;
+    for (int y = 0; y <= map->height; ++y) {
+      for (int x = 0; x <= map->width; ++x) {
+        cells[y * (map->width + 1) + x] =
+            map->grid[cell_index(map, (struct point){x, y})] == WALL;
+      }
+    }
+  }
+  memcpy(published->data + walls_size(map->width, map->height), snake->body,
+         sizeof(uint32_t[snake->length]));
+
+  atomic_store_explicit(&published->sequence, sequence + 2,
+                        memory_order_release);
+}
+
+/// Whether a process is still there.
+static bool alive(const pid_t pid) {
+  return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+/// Whether the game that set up the shared memory is still broadcasting. A game
+/// that crashed left it behind without ending the broadcast.
+static bool running(const struct broadcast *shared) {
+  return shared->magic == BROADCAST_MAGIC && atomic_load(&shared->live) &&
+         alive(shared->owner);
+}
+
+/// Whether the shared memory with the given name belongs to a game that is
+/// still running. One that is being set up counts as running.
+static bool in_use(const char *name) {
+  const int fd = shm_open(name, O_RDONLY, 0);
+  if (fd == -1) {
+    return errno != ENOENT;
+  }
+  // Smaller than its header, the game that created it crashed right away
+  struct stat st;
+  if (fstat(fd, &st) == -1 || st.st_size < (off_t)sizeof(struct broadcast)) {
+    close(fd);
+    return false;
+  }
+  const struct broadcast *shared = mmap(nullptr, sizeof(struct broadcast),
+                                        PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (shared == MAP_FAILED) {
+    return true;
+  }
+  // The owner is written first and the magic last, while it is set up
+  const bool used =
+      running(shared) ||
+      (shared->magic == 0 && (shared->owner == 0 || alive(shared->owner)));
+  munmap((void *)shared, sizeof(struct broadcast));
+  return used;
+}
+
+/// Whether the name still refers to the shared memory of this game. Another
+/// game may have taken it over while it was still being set up.
+static bool owns_name(const char *name) {
+  const int fd = shm_open(name, O_RDONLY, 0);
+  if (fd == -1) {
+    return false;
+  }
+  struct stat named;
+  struct stat own;
+  const bool same = fstat(fd, &named) == 0 && fstat(published_fd, &own) == 0 &&
+                    named.st_dev == own.st_dev && named.st_ino == own.st_ino;
+  close(fd);
+  return same;
+}
+
+bool broadcast_init(void) {
+  char name[32];
+  shared_name(name, sizeof(name));
+  // Only a new object is used, so that another game is never overwritten
+  published_fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (published_fd == -1 && errno == EEXIST) {
+    if (in_use(name)) {
+      return false;
+    }
+    // Left behind by a game that crashed, or by an older version
+    shm_unlink(name);
+    published_fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+  }
+  if (published_fd == -1) { // Another game started in the meantime
+    return errno != EEXIST;
+  }
+
+  // The header is there right away, so that others can tell whose it is
+  void *mapping = MAP_FAILED;
+  if (ftruncate(published_fd, sizeof(struct broadcast)) == 0) {
+    mapping = mmap(nullptr, sizeof(struct broadcast), PROT_READ | PROT_WRITE,
+                   MAP_SHARED, published_fd, 0);
+  }
+  if (mapping == MAP_FAILED) {
+    if (owns_name(name)) {
+      shm_unlink(name);
+    }
+    close(published_fd);
+    published_fd = -1;
+    return true;
+  }
+  published = mapping;
+  published_size = sizeof(struct broadcast);
+  published->owner = getpid();
+  atomic_store(&published->live, true);
+  atomic_store(&published->size, published_size);
+  atomic_thread_fence(memory_order_release);
+  published->magic = BROADCAST_MAGIC;
+  return true;
+}
+
+void broadcast_game(const struct map *map, const struct snake *snake) {
+  if (published == nullptr) {
+    return;
+  }
+
+  const size_t size = sizeof(struct broadcast) +
+                      walls_size(map->width, map->height) +
+                      sizeof(uint32_t[map->area + 1]);
+  if (size > published_size) {
+    if (ftruncate(published_fd, size) == -1) {
+      return;
+    }
+    void *mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                         published_fd, 0);
+    if (mapping == MAP_FAILED) {
+      return;
+    }
+    munmap(published, published_size);
+    published = mapping;
+    published_size = size;
+    atomic_store(&published->size, size);
+  }
+
+  ++game;
+  write_snapshot(map, snake, true);
+}
+
+void broadcast_tick(const struct map *map, const struct snake *snake,
+                    const bool grew) {
+  if (published == nullptr) {
+    return;
+  }
+
+  ++last_tick;
+  struct event *event = &published->events[last_tick & (EVENTS - 1)];
+  atomic_store_explicit(&event->sequence, 2 * last_tick + 1,
+                        memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  event->change = (struct change){game, snake->length, map->apple,
+                                  snake->direction, grew};
+  atomic_store_explicit(&event->sequence, 2 * last_tick + 2,
+                        memory_order_release);
+  atomic_store_explicit(&published->tick, last_tick, memory_order_release);
+
+  if (last_tick % SNAPSHOT_INTERVAL == 0) {
+    write_snapshot(map, snake, false);
+  }
+}
+
+void broadcast_finalize(void) {
+  // Unlinked before the broadcast ends, as a game starting once it has ended
+  // creates its own under the same name
+  if (published_fd != -1) {
+    char name[32];
+    shared_name(name, sizeof(name));
+    if (owns_name(name)) {
+      shm_unlink(name);
+    }
+    close(published_fd);
+    published_fd = -1;
+  }
+  if (published != nullptr) {
+    atomic_store(&published->live, false);
+    munmap(published, published_size);
+    published = nullptr;
+    published_size = 0;
+  }
+}
+
+/// State of a spectator.
+struct view {
+  const struct broadcast *shared;
+  size_t size;
+  int fd;
+  /// Copy of the snapshot data, as big as the shared memory allows.
+  unsigned char *copy;
+  struct map *map;
+  struct snake *snake;
+  uint32_t game;
+  /// Last tick drawn.
+  uint64_t tick;
+};
+
+/// Maps the shared memory again if it grew. Returns `false` on failure.
+static bool remap(struct view *view) {
+  const size_t size = view->shared == nullptr
+                          ? sizeof(struct broadcast)
+                          : atomic_load(&view->shared->size);
+  if (size <= view->size) {
+    return true;
+  }
+  void *mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, view->fd, 0);
+  if (mapping == MAP_FAILED) {
+    return false;
+  }
+  if (view->shared != nullptr) {
+    munmap((void *)view->shared, view->size);
+  }
+  view->shared = mapping;
+  view->size = size;
+  free(view->copy);
+  view->copy = malloc(size - sizeof(struct broadcast));
+  // The first mapping only covers the header, now the real size is known
+  return remap(view);
+}
+
+/// Outcome of `resync`.
+enum sync {
+  SYNCED,
+  /// The snapshot cannot be used yet.
+  NOT_READY,
+  /// The map of the game does not fit the terminal.
+  TOO_BIG
+};
+
+/// Draws the game from scratch out of the last snapshot.
+static enum sync resync(struct view *view, const enum render_mode mode) {
+  const struct broadcast *shared = view->shared;
+  struct snapshot snapshot;
+  size_t walls, body;
+  while (true) {
+    const uint64_t sequence =
+        atomic_load_explicit(&shared->sequence, memory_order_acquire);
+    if (sequence & 1) { // The game is writing it right now
+      continue;
+    }
+    snapshot = shared->snapshot;
+    walls = walls_size(snapshot.width, snapshot.height);
+    body = sizeof(uint32_t[snapshot.length]);
+    const bool fits = snapshot.width >= 0 && snapshot.height >= 0 &&
+                      snapshot.length > 0 &&
+                      walls + body <= view->size - sizeof(struct broadcast);
+    if (fits) {
+      memcpy(view->copy, shared->data, walls + body);
+    }
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&shared->sequence, memory_order_relaxed) ==
+        sequence) {
+      if (!fits) { // Consistent but bigger than the mapping
+        return NOT_READY;
+      }
+      break;
+    }
+  }
+
+  const struct level level = {snapshot.width, snapshot.height, {-1, -1},
+                              (bool *)view->copy};
+  if (!level_fits(&level, mode)) {
+    return TOO_BIG;
+  }
+  map_destroy(view->map);
+  struct map *map = view->map = map_create(mode, &level);
+  const uint32_t *cells = (uint32_t *)(view->copy + walls);
+  snake_destroy(view->snake);
+  struct snake *snake = view->snake =
+      snake_create(cells[0], map->area, map->stride);
+  if (snapshot.length > map->area) {
+    return NOT_READY;
+  }
+  memcpy(snake->body, cells, body);
+  snake->length = snapshot.length;
+  snake->head = snake->body[snake->length - 1];
+  snake->direction = snapshot.direction;
+  if ((map->apple = snapshot.apple) != 0) {
+    set_cell(map, map->apple, FOOD);
+  }
+
+  erase();
+  draw_walls(map);
+  update_score(map, snake->length);
+  set_color(GREEN);
+  for (size_t i = 0; i < snake->length; ++i) {
+    const uint32_t cell = snake->body[i];
+    if (map->grid[cell] != WALL) { // The head may have hit a wall
+      if (i == snake->length - 1) {
+        set_color(BRIGHT_GREEN);
+      }
+      draw_point(map, cell);
+      set_cell(map, cell, BODY);
+    }
+  }
+  if (map->apple != 0) {
+    set_color(MAGENTA);
+    draw_point(map, map->apple);
+  }
+
+  view->game = snapshot.game;
+  view->tick = snapshot.tick;
+  return SYNCED;
+}
+
+/// Reads the change of `tick`. Returns `false` if it was overwritten.
+static bool read_event(const struct broadcast *shared, const uint64_t tick,
+                       struct change *change) {
+  const struct event *event = &shared->events[tick & (EVENTS - 1)];
+  const uint64_t sequence =
+      atomic_load_explicit(&event->sequence, memory_order_acquire);
+  if (sequence != 2 * tick + 2) {
+    return false;
+  }
+  *change = event->change;
+  atomic_thread_fence(memory_order_acquire);
+  return atomic_load_explicit(&event->sequence, memory_order_relaxed) ==
+         sequence;
+}
+
+/// Replays a tick the same way the game played it.
+static void apply(struct view *view, const struct change *change) {
+  struct map *map = view->map;
+  struct snake *snake = view->snake;
+  if (change->grew) {
+    snake->growing = true;
+    ++snake->length;
+    update_score(map, snake->length);
+  }
+  snake->direction = change->direction;
+  advance(snake);
+
+  if (!is_inside(map, snake)) {
+    set_color(RED);
+    draw_point(map, snake->length > 1 ? snake->body[snake->length - 2]
+                                      : snake->old_tail);
+  } else {
+    redraw_snake(map, snake);
+  }
+  if (self_collision(snake)) {
+    set_color(RED);
+    draw_point(map, snake->head);
+  }
+  if (change->apple != map->apple && change->apple != 0) {
+    map->apple = change->apple;
+    set_cell(map, map->apple, FOOD);
+    set_color(MAGENTA);
+    draw_point(map, map->apple);
+  }
+}
+
+enum spectate_end spectate(const enum render_mode mode) {
+  char name[32];
+  shared_name(name, sizeof(name));
+  struct view view = {.fd = shm_open(name, O_RDONLY, 0)};
+  if (view.fd == -1) {
+    return NO_GAME;
+  }
+  // Reading past the end of the shared memory would crash
+  struct stat st;
+  if (fstat(view.fd, &st) == -1 ||
+      st.st_size < (off_t)sizeof(struct broadcast)) {
+    close(view.fd);
+    return NO_GAME;
+  }
+  if (!remap(&view) || !running(view.shared)) {
+    if (view.shared != nullptr) {
+      munmap((void *)view.shared, view.size);
+    }
+    free(view.copy);
+    close(view.fd);
+    return NO_GAME;
+  }
+
+  term_init();
+  enum spectate_end end = WATCHED;
+  bool synced = false;
+  while (running(view.shared) && getch() != 'q' && remap(&view)) {
+    const uint64_t latest =
+        atomic_load_explicit(&view.shared->tick, memory_order_acquire);
+    if (!synced || latest - view.tick >= EVENTS) {
+      const enum sync sync = resync(&view, mode);
+      if (sync == TOO_BIG) {
+        end = MAP_TOO_BIG;
+        break;
+      }
+      synced = sync == SYNCED;
+    }
+    struct change change;
+    while (synced && view.tick < latest) {
+      // A tick of another game, or overwritten because we are too slow
+      synced = read_event(view.shared, view.tick + 1, &change) &&
+               change.game == view.game;
+      if (synced) {
+        apply(&view, &change);
+        ++view.tick;
+      }
+    }
+    refresh();
+    nanosleep(&(struct timespec){0, 8'333'333}, nullptr);
+  }
+
+  snake_destroy(view.snake);
+  map_destroy(view.map);
+  munmap((void *)view.shared, view.size);
+  free(view.copy);
+  close(view.fd);
+  term_finalize();
+  return end;
+}
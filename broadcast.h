@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: GPL-3.0-only
+// Copyright © 2024  Mario D'Andrea https://ormai.me
+
+// Broadcast of a game to spectators on the same host, through POSIX shared
+// memory. Each tick the game publishes what changed in a ring buffer, and every
+// so often a full snapshot of the snake, each protected by a sequence lock. The
+// game never waits for spectators: a spectator that falls behind starts over
+// from the last snapshot. Only one game of each user is broadcast at a time.
+
+#ifndef BROADCAST_H
+#define BROADCAST_H
+
+#include "map.h"
+#include "snake.h"
+
+/// How watching a game ended.
+enum spectate_end {
+  /// The game ended or the spectator quit.
+  WATCHED,
+  /// There is no game to watch.
+  NO_GAME,
+  /// The map of the game does not fit the terminal of the spectator.
+  MAP_TOO_BIG
+};
+
+/// Starts the broadcast. Returns `false` if another game of the same user is
+/// being broadcast. Without shared memory the game simply is not broadcast.
+[[nodiscard]] bool broadcast_init(void);
+
+/// Shares a new game with the spectators.
+void broadcast_game(const struct map *map, const struct snake *snake);
+
+/// Shares the tick that just happened. `grew` tells whether the snake grew
+/// while advancing.
+void broadcast_tick(const struct map *map, const struct snake *snake,
+                    const bool grew);
+
+/// Ends the broadcast, the spectators stop watching.
+void broadcast_finalize(void);
+
+/// Watches the game broadcast on this host until it ends or the user quits.
+enum spectate_end spectate(const enum render_mode mode);
+
+#endif // BROADCAST_H
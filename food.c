@@ -0,0 +1,232 @@
+// SPDX-License-Identifier: GPL-3.0-only
+// Copyright © 2024  Mario D'Andrea https://ormai.me
+
+#include <stdlib.h>
+
+#include "food.h"
+#include "map.h"
+#include "term.h"
+#include "window.h"
+
+/// Slots in each of the two levels of the timer wheel. The first level has a
+/// slot for each of the next ticks, the second one for each run of
+/// `WHEEL_SLOTS` ticks after those.
+#define WHEEL_SLOTS 64
+/// The longest a timer can wait, in ticks.
+#define MAX_DELAY (WHEEL_SLOTS * (WHEEL_SLOTS - 1) - 1)
+/// Ticks before food comes back after it is eaten or goes bad, at random
+/// between the two.
+#define MIN_RESPAWN 10
+#define MAX_RESPAWN 60
+/// Ticks a bonus lasts, at random between the two.
+#define MIN_FRESHNESS 60
+#define MAX_FRESHNESS 180
+/// Ticks between two moves of a mouse.
+#define MOUSE_PACE 3
+/// No item, at the end of a list of timers.
+#define NONE (-1)
+
+enum kind { PLAIN, BONUS, MOUSE };
+
+static const enum color colors[] = {
+    [PLAIN] = MAGENTA, [BONUS] = BRIGHT_CYAN, [MOUSE] = WHITE};
+/// Cells the snake grows for each kind of food.
+static const unsigned worth[] = {[PLAIN] = 1, [BONUS] = 3, [MOUSE] = 2};
+/// Half of the items are plain food, a quarter bonuses and a quarter mice.
+static const enum kind mix[] = {PLAIN, BONUS, PLAIN, MOUSE};
+
+struct item {
+  enum kind kind;
+  /// Where the item is, or `0` while it is off the map.
+  uint32_t cell;
+  /// Tick when the timer of the item goes off.
+  uint64_t due;
+  /// Slot of the wheel where the timer waits, or `NONE` if it is not set.
+  int slot;
+  /// The other timers in the same slot.
+  int previous, next;
+};
+
+struct food {
+  struct item *items;
+  unsigned count;
+  /// One more than the index of the item at each cell of the map, `0` where
+  /// there is none. It tells what the head of the snake is eating.
+  unsigned *at;
+  /// Ticks gone by.
+  uint64_t now;
+  /// First timer in each slot of the wheel, the first level then the second.
+  int wheel[2 * WHEEL_SLOTS];
+};
+
+/// Adds the timer of an item to a slot of the wheel.
+static void wait_in(struct food *food, const int i, const int slot) {
+  struct item *item = &food->items[i];
+  item->slot = slot;
+  item->previous = NONE;
+  item->next = food->wheel[item->slot];
+  if (item->next != NONE) {
+    food->items[item->next].previous = i;
+  }
+  food->wheel[item->slot] = i;
+}
+
+/// Sets the timer of an item to go off `delay` ticks from now.
+static void schedule(struct food *food, const int i, unsigned delay) {
+  struct item *item = &food->items[i];
+  delay = delay < 1 ? 1 : delay > MAX_DELAY ? MAX_DELAY : delay;
+  item->due = food->now + delay;
+  wait_in(food, i,
+          delay < WHEEL_SLOTS
+              ? (int)(item->due % WHEEL_SLOTS)
+              : WHEEL_SLOTS + (int)(item->due / WHEEL_SLOTS % WHEEL_SLOTS));
+}
+
+/// Stops the timer of an item, if it is set.
+static void cancel(struct food *food, const int i) {
+  struct item *item = &food->items[i];
+  if (item->slot == NONE) {
+    return;
+  }
+  if (item->previous != NONE) {
+    food->items[item->previous].next = item->next;
+  } else {
+    food->wheel[item->slot] = item->next;
+  }
+  if (item->next != NONE) {
+    food->items[item->next].previous = item->previous;
+  }
+  item->slot = NONE;
+}
+
+/// Returns a random number of ticks from `min` to `max`.
+static unsigned ticks(const unsigned min, const unsigned max) {
+  return min + rand() % (max - min + 1);
+}
+
+/// Puts an item back on a random empty cell, or tries again later if there is
+/// none.
+static void put(struct food *food, struct map *map, const int i) {
+  struct item *item = &food->items[i];
+  if (map->empty_count == 0) {
+    schedule(food, i, ticks(MIN_RESPAWN, MAX_RESPAWN));
+    return;
+  }
+  item->cell = map->empty_cells[rand() % map->empty_count];
+  set_cell(map, item->cell, FOOD);
+  food->at[item->cell] = i + 1;
+  set_color(colors[item->kind]);
+  draw_point(map, item->cell);
+
+  if (item->kind == BONUS) {
+    schedule(food, i, ticks(MIN_FRESHNESS, MAX_FRESHNESS));
+  } else if (item->kind == MOUSE) {
+    schedule(food, i, MOUSE_PACE);
+  }
+}
+
+/// Takes an item off the map. The snake may be over it, in that case the cell
+/// is left alone.
+static void take(struct food *food, struct map *map, const int i) {
+  struct item *item = &food->items[i];
+  food->at[item->cell] = 0;
+  if (map->grid[item->cell] == FOOD) {
+    set_cell(map, item->cell, EMPTY);
+    erase_point(map, item->cell);
+  }
+  item->cell = 0;
+}
+
+/// Moves a mouse to a random empty cell next to it, if there is one.
+static void scurry(struct food *food, struct map *map, const int i) {
+  struct item *item = &food->items[i];
+  const int steps[] = {-map->stride, 1, map->stride, -1};
+  const uint32_t to = item->cell + steps[rand() % 4];
+  if (map->grid[to] == EMPTY) {
+    take(food, map, i);
+    item->cell = to;
+    set_cell(map, to, FOOD);
+    food->at[to] = i + 1;
+    set_color(colors[MOUSE]);
+    draw_point(map, to);
+  }
+  schedule(food, i, MOUSE_PACE);
+}
+
+/// Does what an item has to do when its timer goes off.
+static void expire(struct food *food, struct map *map, const int i) {
+  struct item *item = &food->items[i];
+  if (item->cell == 0) {
+    put(food, map, i);
+  } else if (map->grid[item->cell] != FOOD) {
+    // The head of the snake is over it, it is eaten at the next tick
+    schedule(food, i, 1);
+  } else if (item->kind == BONUS) {
+    take(food, map, i);
+    schedule(food, i, ticks(MIN_RESPAWN, MAX_RESPAWN));
+  } else if (item->kind == MOUSE) {
+    scurry(food, map, i);
+  }
+}
+
+struct food *food_create(struct map *map, const unsigned count) {
+  struct food *food = calloc(1, sizeof(struct food));
+  food->count = count;
+  food->items = malloc(sizeof(struct item[count]));
+  food->at = calloc((size_t)map->stride * (map->height + 3), sizeof(unsigned));
+  for (int slot = 0; slot < 2 * WHEEL_SLOTS; ++slot) {
+    food->wheel[slot] = NONE;
+  }
+  for (unsigned i = 0; i < count; ++i) {
+    food->items[i] = (struct item){.kind = mix[i % 4], .slot = NONE};
+    put(food, map, i);
+  }
+  return food;
+}
+
+void food_destroy(struct food *food) {
+  if (food != nullptr) {
+    free(food->items);
+    free(food->at);
+    free(food);
+    food = nullptr;
+  }
+}
+
+unsigned eat_food(struct food *food, const uint32_t cell) {
+  if (food->at[cell] == 0) {
+    return 0;
+  }
+  // The head of the snake has already taken the cell
+  const int i = food->at[cell] - 1;
+  food->at[cell] = 0;
+  food->items[i].cell = 0;
+  cancel(food, i);
+  schedule(food, i, ticks(MIN_RESPAWN, MAX_RESPAWN));
+  return worth[food->items[i].kind];
+}
+
+void update_food(struct food *food, struct map *map) {
+  ++food->now;
+  if (food->now % WHEEL_SLOTS == 0) {
+    // The timers of the next run of ticks move down to the first level
+    const int slot = WHEEL_SLOTS + food->now / WHEEL_SLOTS % WHEEL_SLOTS;
+    int i = food->wheel[slot];
+    food->wheel[slot] = NONE;
+    while (i != NONE) {
+      const int next = food->items[i].next;
+      wait_in(food, i, food->items[i].due % WHEEL_SLOTS);
+      i = next;
+    }
+  }
+
+  const int slot = food->now % WHEEL_SLOTS;
+  int i = food->wheel[slot];
+  food->wheel[slot] = NONE;
+  while (i != NONE) {
+    const int next = food->items[i].next;
+    food->items[i].slot = NONE;
+    expire(food, map, i);
+    i = next;
+  }
+}
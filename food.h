@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: GPL-3.0-only
+// Copyright © 2024  Mario D'Andrea https://ormai.me
+
+// Food besides the apple, for games with many items on the map at once. Plain
+// food stays until it is eaten, bonus food is worth more but goes bad after a
+// while, and mice run around. Whatever is eaten or goes bad comes back later
+// somewhere else. Items that have something to do at a later tick wait for it
+// on a timer wheel, so a tick costs as much as the items due in it, however
+// many there are.
+
+#ifndef FOOD_H
+#define FOOD_H
+
+#include <stdint.h>
+
+#include "map.h"
+
+struct food;
+
+/// Creates `count` items of food and puts them on empty cells of `map`. This
+/// function allocates memory.
+[[nodiscard]] struct food *food_create(struct map *map, const unsigned count);
+
+/// Destroys the food created with `food_create`.
+void food_destroy(struct food *food);
+
+/// Eats whatever food is at `cell`. Returns how many cells the snake grows for
+/// it, `0` if there is no food.
+[[nodiscard]] unsigned eat_food(struct food *food, const uint32_t cell);
+
+/// Moves on to the next tick: bonus food goes bad, mice move, and food that
+/// was eaten comes back when its time comes.
+void update_food(struct food *food, struct map *map);
+
+#endif // FOOD_H
@@ -0,0 +1,351 @@
+// SPDX-License-Identifier: GPL-3.0-only
+// Copyright © 2024  Mario D'Andrea https://ormai.me
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <unistd.h>
+
+#include "generator.h"
+#include "level.h"
+
+/// Candidates tried for a seed before giving up.
+#define MAX_CANDIDATES 256
+#define MAX_WORKERS 8
+/// Free cells must be at least this percentage of the map.
+#define MIN_FREE_PERCENT 50
+/// Distance between the walls of a maze, the corridors are one cell narrower.
+#define MAZE_SPACING 4
+/// Rooms are from `MIN_ROOM` to `MAX_ROOM` cells wide and tall, and the doors
+/// between them are `DOOR` cells wide.
+#define MIN_ROOM 8
+#define MAX_ROOM 16
+#define DOOR 3
+
+enum layout { MAZE, ROOMS, BLOCKS };
+
+/// The candidates tried by a worker and the valid one it found, if any.
+struct job {
+  int width, height;
+  uint64_t seed;
+  /// The worker tries the candidates `first`, `first + step` and so on.
+  unsigned first, step;
+  /// Smallest valid candidate found by any worker so far.
+  _Atomic unsigned *found;
+  unsigned candidate;
+  struct level *level;
+};
+
+/// xorshift64*, good enough to lay out walls.
+static uint64_t next(uint64_t *state) {
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return *state * 0x2545f4914f6cdd1dULL;
+}
+
+/// Returns a random number from `0` to `n - 1`.
+static int roll(uint64_t *state, const int n) {
+  return (int)(next(state) % (uint64_t)n);
+}
+
+/// Sets the cells of the rectangle from `(x0, y0)` to `(x1, y1)`, both
+/// included, to walls or to empty cells. The rectangle is clipped to the level.
+static void fill(struct level *level, int x0, int y0, int x1, int y1,
+                 const bool wall) {
+  x0 = x0 < 0 ? 0 : x0;
+  y0 = y0 < 0 ? 0 : y0;
+  x1 = x1 > level->width ? level->width : x1;
+  y1 = y1 > level->height ? level->height : y1;
+  for (int y = y0; y <= y1; ++y) {
+    for (int x = x0; x <= x1; ++x) {
+      level->walls[y * (level->width + 1) + x] = wall;
+    }
+  }
+}
+
+/// Opens the wall between two neighboring rooms of a maze, numbered row after
+/// row in a maze `columns` rooms wide.
+static void open_wall(struct level *level, const unsigned a, const unsigned b,
+                      const int columns) {
+  const unsigned room = a < b ? a : b;
+  const int x = room % columns * MAZE_SPACING,
+            y = room / columns * MAZE_SPACING;
+  if (a + 1 == b || b + 1 == a) {
+    fill(level, x + MAZE_SPACING - 1, y, x + MAZE_SPACING - 1,
+         y + MAZE_SPACING - 2, false);
+  } else {
+    fill(level, x, y + MAZE_SPACING - 1, x + MAZE_SPACING - 2,
+         y + MAZE_SPACING - 1, false);
+  }
+}
+
+/// Carves a maze out of a grid of rooms with a depth first search, then opens
+/// some more walls, so that there is more than one way around.
+static void carve_maze(struct level *level, uint64_t *rng, unsigned *stack,
+                       bool *visited) {
+  const int columns = (level->width + 1) / MAZE_SPACING,
+            rows = (level->height + 1) / MAZE_SPACING;
+  if (columns < 2 || rows < 2) {
+    return;
+  }
+  // The rooms of the last column and row also take the cells left over
+  for (int i = 1; i < columns; ++i) {
+    const int x = i * MAZE_SPACING - 1;
+    fill(level, x, 0, x, level->height, true);
+  }
+  for (int j = 1; j < rows; ++j) {
+    const int y = j * MAZE_SPACING - 1;
+    fill(level, 0, y, level->width, y, true);
+  }
+
+  const unsigned rooms = columns * rows;
+  memset(visited, 0, rooms);
+  size_t top = 0;
+  stack[top++] = 0;
+  visited[0] = true;
+  while (top > 0) {
+    const unsigned room = stack[top - 1];
+    const int i = room % columns, j = room / columns;
+    unsigned choices[4];
+    int count = 0;
+    if (j > 0 && !visited[room - columns]) {
+      choices[count++] = room - columns;
+    }
+    if (i + 1 < columns && !visited[room + 1]) {
+      choices[count++] = room + 1;
+    }
+    if (j + 1 < rows && !visited[room + columns]) {
+      choices[count++] = room + columns;
+    }
+    if (i > 0 && !visited[room - 1]) {
+      choices[count++] = room - 1;
+    }
+    if (count == 0) {
+      --top;
+      continue;
+    }
+    const unsigned chosen = choices[roll(rng, count)];
+    open_wall(level, room, chosen, columns);
+    visited[chosen] = true;
+    stack[top++] = chosen;
+  }
+
+  for (unsigned loops = rooms / 8; loops > 0; --loops) {
+    const unsigned room = roll(rng, rooms);
+    if (roll(rng, 2) == 0 && (int)(room % columns) + 1 < columns) {
+      open_wall(level, room, room + 1, columns);
+    } else if ((int)(room / columns) + 1 < rows) {
+      open_wall(level, room, room + columns, columns);
+    }
+  }
+}
+
+/// Places the walls between rooms at random distances along `length` cells.
+/// Returns how many there are, `lines` also gets `-1` and `length` at the ends.
+static int place_lines(uint64_t *rng, const int length, int *lines) {
+  int count = 0;
+  lines[count++] = -1;
+  for (int at = MIN_ROOM + roll(rng, MAX_ROOM - MIN_ROOM + 1);
+       at < length - MIN_ROOM;
+       at += MIN_ROOM + 1 + roll(rng, MAX_ROOM - MIN_ROOM + 1)) {
+    lines[count++] = at;
+  }
+  lines[count++] = length;
+  return count;
+}
+
+/// Divides the map into rooms, with a door in each wall between two of them.
+static void build_rooms(struct level *level, uint64_t *rng, int *lines) {
+  int *xs = lines, *ys = lines + level->width + 3;
+  const int columns = place_lines(rng, level->width + 1, xs),
+            rows = place_lines(rng, level->height + 1, ys);
+
+  for (int i = 1; i < columns - 1; ++i) {
+    fill(level, xs[i], 0, xs[i], level->height, true);
+  }
+  for (int j = 1; j < rows - 1; ++j) {
+    fill(level, 0, ys[j], level->width, ys[j], true);
+  }
+  for (int i = 1; i < columns - 1; ++i) {
+    for (int j = 0; j < rows - 1; ++j) {
+      const int begin = ys[j] + 1, length = ys[j + 1] - begin;
+      const int door = length > DOOR ? begin + roll(rng, length - DOOR) : begin;
+      fill(level, xs[i], door, xs[i], door + DOOR - 1, false);
+    }
+  }
+  for (int j = 1; j < rows - 1; ++j) {
+    for (int i = 0; i < columns - 1; ++i) {
+      const int begin = xs[i] + 1, length = xs[i + 1] - begin;
+      const int door = length > DOOR ? begin + roll(rng, length - DOOR) : begin;
+      fill(level, door, ys[j], door + DOOR - 1, ys[j], false);
+    }
+  }
+}
+
+/// Whether the rectangle from `(x0, y0)` to `(x1, y1)` is all empty.
+static bool empty(const struct level *level, const int x0, const int y0,
+                  const int x1, const int y1) {
+  for (int y = y0; y <= y1; ++y) {
+    for (int x = x0; x <= x1; ++x) {
+      if (level->walls[y * (level->width + 1) + x]) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/// Scatters small blocks of walls, about one for every 40 cells. The blocks
+/// keep a cell of distance from each other and from the border, so that they
+/// cannot close off any part of the map.
+static void scatter_blocks(struct level *level, uint64_t *rng) {
+  if (level->width < 2 || level->height < 2) {
+    return;
+  }
+  const int cells = (level->width + 1) * (level->height + 1);
+  for (int blocks = cells / 40; blocks > 0; --blocks) {
+    const int x0 = 1 + roll(rng, level->width - 1),
+              y0 = 1 + roll(rng, level->height - 1);
+    const int x1 = x0 + roll(rng, 4), y1 = y0 + roll(rng, 3);
+    if (x1 < level->width && y1 < level->height &&
+        empty(level, x0 - 1, y0 - 1, x1 + 1, y1 + 1)) {
+      fill(level, x0, y0, x1, y1, true);
+    }
+  }
+}
+
+/// Lays out the walls of a candidate. The snake spawns in the middle of the
+/// map, which is always left empty.
+static void generate(struct level *level, const uint64_t seed,
+                     const unsigned candidate, unsigned *scratch,
+                     bool *marks) {
+  uint64_t rng = (seed * 0x9e3779b97f4a7c15ULL ^
+                  candidate * 0xbf58476d1ce4e5b9ULL) |
+                 1;
+  next(&rng);
+
+  fill(level, 0, 0, level->width, level->height, false);
+  switch ((enum layout)(seed % (BLOCKS + 1))) {
+  case MAZE:
+    carve_maze(level, &rng, scratch, marks);
+    break;
+  case ROOMS:
+    build_rooms(level, &rng, (int *)scratch);
+    break;
+  case BLOCKS:
+    scatter_blocks(level, &rng);
+    break;
+  }
+
+  level->spawn = (struct point){level->width / 2, level->height / 2};
+  fill(level, level->spawn.x - 1, level->spawn.y - 1, level->spawn.x + 1,
+       level->spawn.y + 1, false);
+}
+
+/// Checks that the free cells of a candidate are enough and all reachable from
+/// the spawn point.
+static bool validate(const struct level *level, unsigned *queue,
+                     bool *reached) {
+  const int stride = level->width + 1;
+  const size_t cells = (size_t)stride * (level->height + 1);
+  size_t free_cells = 0;
+  for (size_t i = 0; i < cells; ++i) {
+    free_cells += !level->walls[i];
+  }
+  if (free_cells * 100 < cells * MIN_FREE_PERCENT) {
+    return false;
+  }
+
+  memset(reached, 0, cells);
+  size_t first = 0, last = 0;
+  const unsigned spawn = level->spawn.y * stride + level->spawn.x;
+  reached[spawn] = true;
+  queue[last++] = spawn;
+  while (first < last) {
+    const unsigned cell = queue[first++];
+    const int x = cell % stride, y = cell / stride;
+    const unsigned neighbors[] = {
+        y > 0 ? cell - stride : cell, x < level->width ? cell + 1 : cell,
+        y < level->height ? cell + stride : cell, x > 0 ? cell - 1 : cell};
+    for (int i = 0; i < 4; ++i) {
+      const unsigned n = neighbors[i];
+      if (!level->walls[n] && !reached[n]) {
+        reached[n] = true;
+        queue[last++] = n;
+      }
+    }
+  }
+  return last == free_cells;
+}
+
+/// Tries the candidates of a job until one is valid, or a smaller valid one was
+/// found by another worker.
+static int work(void *argument) {
+  struct job *job = argument;
+  const size_t cells = (size_t)(job->width + 1) * (job->height + 1);
+  unsigned *scratch = malloc(sizeof(unsigned[cells + job->width + job->height +
+                                              6]));
+  bool *marks = malloc(sizeof(bool[cells]));
+  struct level *level = malloc(sizeof(struct level));
+  level->width = job->width;
+  level->height = job->height;
+  level->walls = malloc(sizeof(bool[cells]));
+
+  for (unsigned candidate = job->first; candidate < atomic_load(job->found);
+       candidate += job->step) {
+    generate(level, job->seed, candidate, scratch, marks);
+    if (validate(level, scratch, marks)) {
+      unsigned found = atomic_load(job->found);
+      while (candidate < found &&
+             !atomic_compare_exchange_weak(job->found, &found, candidate)) {
+      }
+      job->candidate = candidate;
+      job->level = level;
+      level = nullptr;
+      break;
+    }
+  }
+
+  level_destroy(level);
+  free(scratch);
+  free(marks);
+  return 0;
+}
+
+struct level *level_generate(const int width, const int height,
+                             const uint64_t seed) {
+  const long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  const unsigned workers = cores < 1             ? 1
+                           : cores > MAX_WORKERS ? MAX_WORKERS
+                                                 : (unsigned)cores;
+  _Atomic unsigned found = MAX_CANDIDATES;
+  struct job jobs[MAX_WORKERS];
+  thrd_t threads[MAX_WORKERS];
+  bool started[MAX_WORKERS];
+  for (unsigned i = 0; i < workers; ++i) {
+    jobs[i] = (struct job){width, height, seed, i, workers, &found, 0, nullptr};
+    started[i] = thrd_create(&threads[i], work, &jobs[i]) == thrd_success;
+  }
+  for (unsigned i = 0; i < workers; ++i) {
+    if (!started[i]) { // Do the work of the missing thread here
+      work(&jobs[i]);
+    }
+  }
+
+  struct level *level = nullptr;
+  for (unsigned i = 0; i < workers; ++i) {
+    if (started[i]) {
+      thrd_join(threads[i], nullptr);
+    }
+    if (jobs[i].level != nullptr && jobs[i].candidate == found) {
+      level = jobs[i].level;
+    } else {
+      level_destroy(jobs[i].level);
+    }
+  }
+  return level;
+}
@@ -0,0 +1,24 @@
+// SPDX-License-Identifier: GPL-3.0-only
+// Copyright © 2024  Mario D'Andrea https://ormai.me
+
+// Levels made up from a seed instead of being loaded from a file. The seed
+// picks the layout, a maze, rooms or scattered blocks, and each candidate level
+// of that layout is kept only if all of its free cells are connected and they
+// take at least half of the map, so that every apple can be reached.
+// Candidates are generated on all the cores at once. The first valid candidate
+// in the order of the seed wins, so the same seed always makes the same level.
+
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <stdint.h>
+
+#include "level.h"
+
+/// Generates a level of the given size, see `struct level`. Returns `nullptr`
+/// if no valid level came out of the seed. This function allocates memory, the
+/// level is destroyed with `level_destroy`.
+[[nodiscard]] struct level *level_generate(const int width, const int height,
+                                           const uint64_t seed);
+
+#endif // GENERATOR_H
@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: GPL-3.0-only
+// Copyright © 2024  Mario D'Andrea https://ormai.me
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "level.h"
+
+struct level *level_load(const char *path) {
+  const int fd = open(path, O_RDONLY);
+  if (fd == -1) {
+    return nullptr;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == -1 || st.st_size == 0) {
+    close(fd);
+    return nullptr;
+  }
+  const size_t size = st.st_size;
+  const char *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return nullptr;
+  }
+
+  // Measure the level first, then fill it in with a second pass
+  int columns = 0, rows = 0;
+  for (size_t i = 0, begin = 0; i <= size; ++i) {
+    if (i == size || data[i] == '\n') {
+      int length = i - begin;
+      if (length > 0 && data[i - 1] == '\r') {
+        --length;
+      }
+      if (length > columns) {
+        columns = length;
+      }
+      if (i < size || length > 0) {
+        ++rows;
+      }
+      begin = i + 1;
+    }
+  }
+  if (columns == 0) {
+    munmap((void *)data, size);
+    return nullptr;
+  }
+
+  struct level *level = malloc(sizeof(struct level));
+  level->width = columns - 1;
+  level->height = rows - 1;
+  level->spawn = (struct point){-1, -1};
+  level->walls = calloc((size_t)columns * rows, sizeof(bool));
+  size_t walls = 0;
+  for (size_t i = 0, x = 0, y = 0; i < size; ++i) {
+    switch (data[i]) {
+    case '\n':
+      x = 0;
+      ++y;
+      continue;
+    case '#':
+      level->walls[y * columns + x] = true;
+      ++walls;
+      break;
+    case 'S':
+      level->spawn = (struct point){x, y};
+      break;
+    }
+    ++x;
+  }
+
+  munmap((void *)data, size);
+
+  // There must be room at least for the snake and the apple
+  if ((size_t)columns * rows - walls < 2) {
+    level_destroy(level);
+    return nullptr;
+  }
+  return level;
+}
+
+void level_destroy(struct level *level) {
+  if (level != nullptr) {
+    free(level->walls);
+    free(level);
+    level = nullptr;
+  }
+}
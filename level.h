@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: GPL-3.0-only
+// Copyright © 2024  Mario D'Andrea https://ormai.me
+
+// Levels are plain text files, one line for each row of the map and one
+// character for each cell. `#` is a wall and `S` is where the snake spawns,
+// anything else is an empty cell. The map is as wide as the longest line.
+// Empty cells that the snake cannot reach from where it spawns become walls.
+//
+//   ##########
+//   #   S    #
+//   #  ####  #
+//   #        #
+//   ##########
+
+#ifndef LEVEL_H
+#define LEVEL_H
+
+#include "snake.h"
+
+struct level {
+  /// Same as in `struct map`: the coordinates of the last column and row.
+  int width;
+  int height;
+  /// Where the snake spawns, or `{-1, -1}` if the level does not say.
+  struct point spawn;
+  /// Whether each cell is a wall, row after row.
+  bool *walls;
+};
+
+/// Loads a level file. Returns `nullptr` if the file cannot be read or has no
+/// room for the snake and the apple. This function allocates memory.
+[[nodiscard]] struct level *level_load(const char *path);
+
+/// Destroys a level created with `level_load`.
+void level_destroy(struct level *level);
+
+#endif // LEVEL_H
@@ -4,10 +4,19 @@
 #define _POSIX_C_SOURCE 200809L
 
 #include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <threads.h>
 #include <time.h>
 
+#include "ai.h"
+#include "broadcast.h"
+#include "food.h"
+#include "generator.h"
+#include "level.h"
 #include "map.h"
+#include "score.h"
 #include "snake.h"
 #include "term.h"
 #include "window.h"
@@ -27,32 +36,67 @@ struct game_state {
   /// The game waits for the first input of the player.
   bool pre_game;
   enum difficulty difficulty;
+  enum render_mode render_mode;
+  /// Level played in every game, or `nullptr` for an empty map.
+  struct level *level;
+  /// Whether each game is played on a new level generated from `seed`.
+  bool generate;
+  uint64_t seed;
+  /// Whether spectators can watch the game.
+  bool broadcast;
+  /// Whether the autopilot plays instead of the user.
+  bool autopilot;
+  struct ai *ai;
+  /// Items of food on the map besides the apple, none in a classic game.
+  unsigned foods;
+  struct food *food;
+  /// Cells the snake still has to grow, one each tick.
+  unsigned growth;
 };
 
 /// Initializes a new game. Can be used to reset the game.
 static void new_game(struct game_state *game, struct map **m,
                      struct snake **s) {
+  if (game->generate) {
+    level_destroy(game->level);
+    const struct point size = map_size(game->render_mode);
+    game->level = level_generate(size.x, size.y, game->seed++);
+  }
+
   struct map *map = *m;
   map_destroy(map);
-  *m = map = map_create();
+  *m = map = map_create(game->render_mode, game->level);
 
   struct snake *snake = *s;
   snake_destroy(snake);
-  const struct point map_center = {map->width / 2, map->height / 2};
-  *s = snake = snake_create(map_center, map->area);
+  *s = snake = snake_create(map->spawn, map->area, map->stride);
+  set_cell(map, snake->head, BODY);
+
+  if (game->autopilot) {
+    ai_destroy(game->ai);
+    game->ai = ai_create(map);
+  }
 
   erase();
   draw_walls(map);
   spawn_apple(map);
+  if (game->foods > 0) {
+    food_destroy(game->food);
+    game->food = food_create(map, game->foods);
+  }
+  if (game->broadcast) {
+    broadcast_game(map, snake);
+  }
   update_score(map, snake->length);
   set_color(BRIGHT_GREEN);
   draw_point(map, snake->head);
   set_color(DEFAULT_COLOR);
-  print(map->offset.y + map->height + 2, map->offset.x,
+  print(map->offset.y + map->extent.y + 1, map->offset.x,
         "Move in any direction to start the game.");
   nonblocking_input(false);
   game->pre_game = true;
   game->progress = 0;
+  game->growth = 0;
 }
 
 /// Returns the current time in nanoseconds.
@@ -62,13 +106,92 @@ static void new_game(struct game_state *game, struct map **m,
   return ts.tv_sec * SECOND_IN_NANOSECOND + ts.tv_nsec;
 }
 
-int main(void) {
+int main(int argc, char *argv[]) {
+  struct game_state game = {.pre_game = true,
+                            .difficulty = INCREMENTAL,
+                            .render_mode = FULL_BLOCK};
+  bool spectator = false;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--half-block") == 0) {
+      game.render_mode = HALF_BLOCK;
+    } else if (strcmp(argv[i], "--autopilot") == 0) {
+      game.autopilot = true;
+    } else if (strcmp(argv[i], "--broadcast") == 0) {
+      game.broadcast = true;
+    } else if (strcmp(argv[i], "--spectate") == 0) {
+      spectator = true;
+    } else if (strcmp(argv[i], "--level") == 0 && i + 1 < argc &&
+               !game.generate) {
+      level_destroy(game.level);
+      if ((game.level = level_load(argv[++i])) == nullptr) {
+        fprintf(stderr, "%s: cannot load level %s\n", argv[0], argv[i]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--generate") == 0 && i + 1 < argc &&
+               game.level == nullptr) {
+      char *end;
+      game.seed = strtoull(argv[++i], &end, 10);
+      if (*argv[i] == '\0' || *end != '\0') {
+        fprintf(stderr, "%s: the seed must be a number\n", argv[0]);
+        return 1;
+      }
+      game.generate = true;
+    } else if (strcmp(argv[i], "--food") == 0 && i + 1 < argc) {
+      char *end;
+      const unsigned long foods = strtoul(argv[++i], &end, 10);
+      if (*argv[i] == '\0' || *end != '\0' || foods > 10'000) {
+        fprintf(stderr, "%s: the food must be a number up to 10000\n",
+                argv[0]);
+        level_destroy(game.level);
+        return 1;
+      }
+      game.foods = foods;
+    } else {
+      fprintf(stderr,
+              "usage: %s [--half-block] [--autopilot] [--food N] "
+              "[--level FILE | --generate SEED] [--broadcast | --spectate]\n",
+              argv[0]);
+      level_destroy(game.level);
+      return 1;
+    }
+  }
+  if (game.level != nullptr && !level_fits(game.level, game.render_mode)) {
+    fprintf(stderr, "%s: the level does not fit the terminal\n", argv[0]);
+    level_destroy(game.level);
+    return 1;
+  }
+  if (game.foods > 0 && game.broadcast) { // Spectators only know the apple
+    fprintf(stderr, "%s: a game with --food cannot be broadcast\n", argv[0]);
+    level_destroy(game.level);
+    return 1;
+  }
+
   setlocale(LC_ALL, "");
+  if (spectator) {
+    level_destroy(game.level);
+    switch (spectate(game.render_mode)) {
+    case WATCHED:
+      return 0;
+    case NO_GAME:
+      fprintf(stderr, "%s: no game to spectate, start one with --broadcast\n",
+              argv[0]);
+      return 1;
+    case MAP_TOO_BIG:
+      fprintf(stderr, "%s: the map of the game does not fit the terminal\n",
+              argv[0]);
+      return 1;
+    }
+  }
+  if (game.broadcast && !broadcast_init()) {
+    fprintf(stderr, "%s: another game is already being broadcast\n", argv[0]);
+    level_destroy(game.level);
+    return 1;
+  }
+  leaderboard_init();
   term_init();
 
   struct map *map = nullptr;
   struct snake *snake = nullptr;
-  struct game_state game = {.pre_game = true, .difficulty = INCREMENTAL};
   if (!(game.quit = welcome_dialog(&game.difficulty))) {
     new_game(&game, &map, &snake);
   }
@@ -118,23 +241,36 @@ int main(void) {
     if (current_time - last_logic_time >= logic_interval) {
       if (game.pre_game) {
         game.pre_game = false;
-        erase_line(map->offset.y + map->height + 2); // Hide tooltip below map
+        erase_line(map->offset.y + map->extent.y + 1); // Hide tooltip below map
         nonblocking_input(true);
       }
 
-      if (snake->head.x == map->apple.x && snake->head.y == map->apple.y) {
+      const bool ate_apple = snake->head == map->apple;
+      game.growth += ate_apple;
+      if (game.food != nullptr) {
+        game.growth += eat_food(game.food, snake->head);
+      }
+      if (game.growth > 0) {
+        --game.growth;
         snake->growing = true;
         ++snake->length;
-        spawn_apple(map);
         update_score(map, snake->length);
         game.progress = (snake->length + .0) / map->area;
-        if (snake->length == map->area) {
+        if (snake->length == map->area) { // No room left for another apple
+          submit_score(game.difficulty, snake->length);
           if (!(game.quit = win_dialog(map, &game.difficulty, snake->length))) {
             new_game(&game, &map, &snake);
           }
+        } else if (ate_apple) {
+          spawn_apple(map);
         }
       }
 
+      if (game.autopilot) { // Leave at least half of the tick to the rest
+        change_direction(snake, ai_next_direction(game.ai, map, snake,
+                                                  logic_interval / 2));
+      }
+      const bool grew = snake->growing;
       advance(snake);
 
       // Game over after collision
@@ -149,14 +285,28 @@ int main(void) {
         set_color(RED);
         draw_point(map, snake->head);
       }
-      if ((game.wall_collision || game.self_collision) &&
-          !(game.quit = over_dialog(map, &game.difficulty, snake->length))) {
-        new_game(&game, &map, &snake);
+      if (game.food != nullptr) {
+        if (map->apple == 0) { // Food took the last empty cell, try again
+          spawn_apple(map);
+        }
+        update_food(game.food, map);
+      }
+      if (game.broadcast) {
+        broadcast_tick(map, snake, grew);
+      }
+      if (game.wall_collision || game.self_collision) {
+        submit_score(game.difficulty, snake->length);
+        if (!(game.quit = over_dialog(map, &game.difficulty, snake->length))) {
+          new_game(&game, &map, &snake);
+        }
       }
       last_logic_time = current_time;
+      refresh();
     }
 
-    const long long time_left = display_interval - time_ns() - current_time;
+    // Sleep for what is left of the interval once this iteration is done
+    const long long elapsed = time_ns() - current_time,
+                    time_left = display_interval - elapsed;
     if (time_left > 0) {
       nanosleep(&(struct timespec){time_left / SECOND_IN_NANOSECOND,
                                    time_left % SECOND_IN_NANOSECOND},
@@ -164,8 +314,13 @@ int main(void) {
     }
   }
 
+  broadcast_finalize();
+  food_destroy(game.food);
+  ai_destroy(game.ai);
+  level_destroy(game.level);
   snake_destroy(snake);
   map_destroy(map);
   term_finalize();
+  leaderboard_finalize();
   return 0;
 }
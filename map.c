@@ -9,19 +9,145 @@
 #include "term.h"
 #include "window.h"
 
-struct map *map_create(void) {
+/// Returns the columns and rows taken on the terminal by a map of the given
+/// size, walls excluded.
+static struct point extent(const enum render_mode mode, const int width,
+                           const int height) {
+  return mode == HALF_BLOCK
+             ? (struct point){width + 1, (height + 2) / 2}
+             : (struct point){(width + 1) * 2, height + 1};
+}
+
+/// Walls off the cells that cannot be reached from the spawn, so that the apple
+/// never ends up there and the snake can still fill the map. Then lists the free
+/// cells, which are all empty at first, and measures their distance from the
+/// walls.
+static void survey(struct map *map) {
+  const size_t cells = (size_t)map->stride * (map->height + 3);
+  const int steps[] = {-map->stride, 1, map->stride, -1};
+  map->empty_cells = malloc(sizeof(uint32_t[(map->width + 1) *
+                                            (map->height + 1)]));
+  map->empty_position = malloc(sizeof(uint32_t[cells]));
+  map->distance = malloc(sizeof(int[cells]));
+  map->area = 0;
+  uint32_t *queue = malloc(sizeof(uint32_t[cells]));
+
+  // Breadth first search from the spawn, the reached cells are set to `0`
+  for (uint32_t cell = 0; cell < cells; ++cell) {
+    map->distance[cell] = -1;
+  }
+  size_t first = 0, last = 0;
+  map->distance[map->spawn] = 0;
+  queue[last++] = map->spawn;
+  while (first < last) {
+    const uint32_t cell = queue[first++];
+    for (int i = 0; i < 4; ++i) {
+      const uint32_t n = cell + steps[i];
+      if (map->grid[n] != WALL && map->distance[n] == -1) {
+        map->distance[n] = 0;
+        queue[last++] = n;
+      }
+    }
+  }
+  for (uint32_t cell = 0; cell < cells; ++cell) {
+    if (map->distance[cell] == -1) {
+      map->grid[cell] = WALL;
+    }
+  }
+
+  // Breadth first search starting from the cells next to a wall
+  first = last = 0;
+  for (uint32_t cell = 0; cell < cells; ++cell) {
+    if (map->grid[cell] == WALL) {
+      map->distance[cell] = 0;
+      continue;
+    }
+    map->empty_position[cell] = map->area;
+    map->empty_cells[map->area++] = cell;
+    if (map->grid[cell - map->stride] == WALL ||
+        map->grid[cell + 1] == WALL ||
+        map->grid[cell + map->stride] == WALL || map->grid[cell - 1] == WALL) {
+      map->distance[cell] = 1;
+      queue[last++] = cell;
+    } else {
+      map->distance[cell] = -1;
+    }
+  }
+  while (first < last) {
+    const uint32_t cell = queue[first++];
+    for (int i = 0; i < 4; ++i) {
+      const uint32_t n = cell + steps[i];
+      if (map->grid[n] != WALL && map->distance[n] == -1) {
+        map->distance[n] = map->distance[cell] + 1;
+        queue[last++] = n;
+      }
+    }
+  }
+  free(queue);
+}
+
+struct point map_size(const enum render_mode mode) {
+  const struct winsize ws = get_term_size();
+  if (mode == HALF_BLOCK) {
+    // An even number of rows, so that the last terminal row is not half empty
+    return (struct point){ws.ws_col * 2 / 3, (ws.ws_row * 4 / 3 - 1) | 1};
+  }
+  return (struct point){ws.ws_col / 3, ws.ws_row * 2 / 3}; // see translate()
+}
+
+struct map *map_create(const enum render_mode mode,
+                       const struct level *level) {
   struct map *map = malloc(sizeof(struct map));
+  map->mode = mode;
 
   const struct winsize ws = get_term_size();
-  map->width = ws.ws_col / 3; // see translate()
-  map->height = ws.ws_row * 2 / 3;
-  map->area = map->width * map->height;
-  map->offset = (struct point){(ws.ws_col - map->width * 2) / 2,
-                               (ws.ws_row - map->height) / 2};
-
-  map->grid = malloc(sizeof(int * [map->height + 1]));
-  for (int i = 0; i <= map->height; ++i) {
-    map->grid[i] = calloc(map->width + 1, sizeof(int));
+  if (level != nullptr) {
+    map->width = level->width;
+    map->height = level->height;
+  } else {
+    const struct point size = map_size(mode);
+    map->width = size.x;
+    map->height = size.y;
+  }
+  map->extent = extent(mode, map->width, map->height);
+  map->offset = (struct point){(ws.ws_col - map->extent.x) / 2,
+                               (ws.ws_row - map->extent.y) / 2};
+
+  // Allocate one more cell on each side for the border
+  map->stride = map->width + 3;
+  map->grid = malloc((size_t)map->stride * (map->height + 3));
+  for (int i = -1; i <= map->height + 1; ++i) {
+    for (int j = -1; j <= map->width + 1; ++j) {
+      const bool wall =
+          i < 0 || i > map->height || j < 0 || j > map->width ||
+          (level != nullptr && level->walls[i * (map->width + 1) + j]);
+      map->grid[cell_index(map, (struct point){j, i})] = wall ? WALL : EMPTY;
+    }
+  }
+
+  const uint32_t center =
+      cell_index(map, (struct point){map->width / 2, map->height / 2});
+  if (level != nullptr && level->spawn.x >= 0) {
+    map->spawn = cell_index(map, level->spawn);
+  } else {
+    map->spawn = center;
+    while (map->grid[map->spawn] == WALL) { // A level has at least a free cell
+      map->spawn = (map->spawn + 1) % (map->stride * (map->height + 3));
+    }
+  }
+  survey(map);
+  map->empty_count = map->area;
+
+  // In half block mode, the last terminal row may be half outside of the map
+  map->colors = nullptr;
+  if (mode == HALF_BLOCK) {
+    map->colors = malloc(sizeof(enum color * [map->height + 2]));
+    for (int i = 0; i <= map->height + 1; ++i) {
+      map->colors[i] = malloc(sizeof(enum color[map->width + 1]));
+      for (int j = 0; j <= map->width; ++j) {
+        map->colors[i][j] = DEFAULT_COLOR;
+      }
+    }
   }
 
   return map;
@@ -29,43 +155,53 @@ struct map *map_create(void) {
 
 void map_destroy(struct map *map) {
   if (map != nullptr) {
-    if (map->grid != nullptr) {
-      for (int i = 0; i <= map->height; ++i) {
-        free(map->grid[i]);
+    free(map->grid);
+    if (map->colors != nullptr) {
+      for (int i = 0; i <= map->height + 1; ++i) {
+        free(map->colors[i]);
       }
-      free(map->grid);
+      free(map->colors);
     }
+    free(map->empty_cells);
+    free(map->empty_position);
+    free(map->distance);
     free(map);
     map = nullptr;
   }
 }
 
+bool level_fits(const struct level *level, const enum render_mode mode) {
+  // Walls around the map, the score above and the tooltip below
+  const struct winsize ws = get_term_size();
+  const struct point size = extent(mode, level->width, level->height);
+  return size.x + 4 <= ws.ws_col && size.y + 4 <= ws.ws_row;
+}
+
 bool is_inside(const struct map *map, const struct snake *snake) {
-  const struct point head = snake->body[snake->length - 1];
-  return head.x <= map->width && head.x >= 0 && head.y <= map->height &&
-         head.y >= 0;
+  return map->grid[snake->head] != WALL;
+}
+
+void set_cell(struct map *map, const uint32_t cell, const enum cell content) {
+  const bool was_empty = map->grid[cell] == EMPTY;
+  map->grid[cell] = content;
+  if (was_empty && content != EMPTY) { // The last empty cell takes its place
+    const uint32_t last = map->empty_cells[--map->empty_count],
+                   position = map->empty_position[cell];
+    map->empty_cells[position] = last;
+    map->empty_position[last] = position;
+  } else if (!was_empty && content == EMPTY) {
+    map->empty_position[cell] = map->empty_count;
+    map->empty_cells[map->empty_count++] = cell;
+  }
 }
 
 void spawn_apple(struct map *map) {
-  static const unsigned max_tries = 5;
-  unsigned tries = 0;
-  do {
-    if (tries++ > max_tries) {
-      // After max_tries use the first available point
-      bool found_it = false;
-      for (int i = 0; i < map->height && !found_it; ++i) {
-        for (int j = 0; j < map->width && !found_it; ++j) {
-          if (map->grid[i][j] == false) {
-            found_it = true;
-            map->grid[i][j] = true;
-            map->apple = (struct point){i, j};
-          }
-        }
-      }
-    }
-    map->apple.x = rand() % (map->width + 1);
-    map->apple.y = rand() % (map->height + 1);
-  } while (map->grid[map->apple.y][map->apple.x] == true);
+  if (map->empty_count == 0) {
+    map->apple = 0;
+    return;
+  }
+  map->apple = map->empty_cells[rand() % map->empty_count];
+  set_cell(map, map->apple, FOOD);
   set_color(MAGENTA);
   draw_point(map, map->apple);
 }
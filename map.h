@@ -4,34 +4,104 @@
 #ifndef MAP_H
 #define MAP_H
 
+#include <stdint.h>
 #include <sys/ioctl.h>
 
+#include "level.h"
 #include "snake.h"
+#include "term.h"
+
+/// How map cells are laid out on the terminal.
+enum render_mode {
+  /// Each cell is "██", two columns wide and one row tall.
+  FULL_BLOCK,
+  /// Each cell is half of a terminal cell, "▀" or "▄", so that two map rows fit
+  /// in one terminal row. Doubles the vertical resolution and sends fewer bytes
+  /// per cell.
+  HALF_BLOCK
+};
+
+/// Content of a cell of the map.
+enum cell {
+  EMPTY,
+  BODY,
+  WALL,
+  /// The apple or any other food.
+  FOOD
+};
 
 struct map {
   int width;
   int height;
-  /// Cells contained by the map contain. It is simply `width` * `height`.
+  /// Cells of the map that are not walls, the snake can fill all of them.
   unsigned area;
   /// An offset from the top-left corner to center the map.
   struct point offset;
-  /// Position of the apple on the map.
-  struct point apple;
-  /// The map is a 2D array. Each cell contains either `0`, for empty, or `1`
-  /// for taken.
-  int **grid;
+  /// Columns and rows taken by the map on the terminal, walls excluded.
+  struct point extent;
+  enum render_mode mode;
+  /// Cells in a row of `grid`, the border included.
+  int stride;
+  /// Position of the apple on the map, or `0`, a corner of the border, when
+  /// there is no room for it.
+  uint32_t apple;
+  /// Where the snake starts.
+  uint32_t spawn;
+  /// The map is an array of `enum cell`, row after row. It is surrounded by a
+  /// border of walls, so that the cells next to any cell of the map can be
+  /// looked up. See `cell_index`.
+  unsigned char *grid;
+  /// The empty cells, in no particular order, so that one of them can be picked
+  /// at random right away.
+  uint32_t *empty_cells;
+  unsigned empty_count;
+  /// Where each empty cell of `grid` is in `empty_cells`.
+  uint32_t *empty_position;
+  /// Distance of each cell of `grid` from the closest wall. Walls are `0`.
+  int *distance;
+  /// Color of each cell, only used by `HALF_BLOCK`, where two cells share a
+  /// terminal cell and both colors have to be known to draw either of them.
+  enum color **colors;
 };
 
-/// Creates a new map. This function allocates memory.
-[[nodiscard]] struct map *map_create(void);
+/// Returns the index in `grid` of the cell at `point`.
+static inline uint32_t cell_index(const struct map *map,
+                                  const struct point point) {
+  return (point.y + 1) * map->stride + point.x + 1;
+}
+
+/// Returns the coordinates of the cell at `index` in `grid`.
+static inline struct point cell_point(const struct map *map,
+                                      const uint32_t index) {
+  return (struct point){(int)(index % map->stride) - 1,
+                        (int)(index / map->stride) - 1};
+}
+
+/// Returns the width and height of an empty map that fits the terminal when
+/// drawn in `mode`.
+[[nodiscard]] struct point map_size(const enum render_mode mode);
+
+/// Creates a new map with the size and the walls of `level`, or if it is
+/// `nullptr`, an empty map that fits the terminal. This function allocates
+/// memory.
+[[nodiscard]] struct map *map_create(const enum render_mode mode,
+                                     const struct level *level);
 
 /// Destroys a map created with `map_create`.
 void map_destroy(struct map *map);
 
+/// Checks whether `level` fits the terminal when drawn in `mode`.
+[[nodiscard]] bool level_fits(const struct level *level,
+                              const enum render_mode mode);
+
 /// Checks whether the snake has hit any wall.
 bool is_inside(const struct map *map, const struct snake *snake);
 
-/// Spawns a new apple and draws it on the map.
+/// Changes the content of a cell, keeping track of the empty ones. Cells never
+/// become walls.
+void set_cell(struct map *map, const uint32_t cell, const enum cell content);
+
+/// Spawns a new apple on an empty cell and draws it on the map.
 void spawn_apple(struct map *map);
 
 #endif // MAP_H
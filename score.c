@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: GPL-3.0-only
+// Copyright © 2024  Mario D'Andrea https://ormai.me
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "score.h"
+#include "window.h"
+
+/// "SNAKE", followed by the version of the file layout.
+#define LEADERBOARD_MAGIC 0x534e414b45000001ULL
+
+/// Layout of the leaderboard file.
+struct leaderboard {
+  _Atomic uint64_t magic;
+  /// The best scores for each difficulty, in descending order. Each entry
+  /// packs the score in the upper 32 bits and the time of submission in the
+  /// lower ones, so comparing entries compares scores first. `0` is an empty
+  /// entry.
+  _Atomic uint64_t entries[HARD + 1][LEADERBOARD_SIZE];
+};
+
+static struct leaderboard *board = nullptr;
+
+void leaderboard_init(void) {
+  char path[4096];
+  const char *file = getenv("SNAKE_SCORES");
+  if (file == nullptr) {
+    const char *home = getenv("HOME");
+    if (home == nullptr) {
+      return;
+    }
+    snprintf(path, sizeof(path), "%s/.snake_scores", home);
+    file = path;
+  }
+
+  const int fd = open(file, O_RDWR | O_CREAT, 0644);
+  if (fd == -1) {
+    return;
+  }
+  // Only a new, empty file is grown. Growing it fills it with zeros, which is
+  // an empty leaderboard. Games racing to create the file all truncate it to
+  // the same size. Any other file too small for a leaderboard is left alone.
+  struct stat st;
+  if (fstat(fd, &st) == -1 ||
+      (st.st_size != 0 && st.st_size < (off_t)sizeof(struct leaderboard))) {
+    close(fd);
+    return;
+  }
+  const bool empty = st.st_size == 0;
+  if (empty && ftruncate(fd, sizeof(struct leaderboard)) == -1) {
+    close(fd);
+    return;
+  }
+  void *mapping = mmap(nullptr, sizeof(struct leaderboard),
+                       PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    return;
+  }
+
+  board = mapping;
+  // The entries are shared between processes, that only works if the atomic
+  // operations do not fall back to a lock private to each process
+  if (!atomic_is_lock_free(&board->magic)) {
+    leaderboard_finalize();
+    return;
+  }
+  // Only the file that was just grown gets the magic, whatever else does not
+  // start with it is not a leaderboard and is left alone
+  uint64_t magic = 0;
+  if (empty) {
+    atomic_compare_exchange_strong(&board->magic, &magic, LEADERBOARD_MAGIC);
+  }
+  if (atomic_load(&board->magic) != LEADERBOARD_MAGIC) {
+    leaderboard_finalize();
+  }
+}
+
+void leaderboard_finalize(void) {
+  if (board != nullptr) {
+    munmap(board, sizeof(struct leaderboard));
+    board = nullptr;
+  }
+}
+
+void submit_score(const enum difficulty difficulty, const size_t score) {
+  if (board == nullptr || score == 0) {
+    return;
+  }
+
+  // Walk down the leaderboard, swapping the entry in where it beats the current
+  // one and carrying on with the entry it replaced. Every step is a single
+  // compare-and-swap, so a game that crashes halfway leaves a consistent
+  // leaderboard behind, at worst missing the entry it was carrying.
+  _Atomic uint64_t *entries = board->entries[difficulty];
+  uint64_t entry = (uint64_t)(score < UINT32_MAX ? score : UINT32_MAX) << 32 |
+                   (uint32_t)time(nullptr);
+  for (unsigned i = 0; i < LEADERBOARD_SIZE && entry != 0;) {
+    uint64_t current = atomic_load(&entries[i]);
+    if (entry <= current) {
+      ++i;
+    } else if (atomic_compare_exchange_weak(&entries[i], &current, entry)) {
+      entry = current;
+      ++i;
+    }
+  }
+}
+
+size_t best_score(const enum difficulty difficulty, const unsigned rank) {
+  if (board == nullptr || rank >= LEADERBOARD_SIZE) {
+    return 0;
+  }
+  return atomic_load_explicit(&board->entries[difficulty][rank],
+                              memory_order_relaxed) >>
+         32;
+}
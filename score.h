@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: GPL-3.0-only
+// Copyright © 2024  Mario D'Andrea https://ormai.me
+
+// A leaderboard for each difficulty, kept in a small file that every game on
+// the host maps in memory. Scores are submitted with compare-and-swap on the
+// mapped entries, so concurrent games never wait for each other and the file
+// is never rewritten as a whole.
+
+#ifndef SCORE_H
+#define SCORE_H
+
+#include <stddef.h>
+
+#include "window.h"
+
+/// Number of scores kept for each difficulty.
+#define LEADERBOARD_SIZE 10
+
+/// Maps the leaderboard file, creating it if needed. The file is
+/// `$SNAKE_SCORES`, or `~/.snake_scores` by default. When the file cannot be
+/// used the leaderboard stays empty and submitted scores are dropped.
+void leaderboard_init(void);
+
+/// Unmaps the leaderboard file.
+void leaderboard_finalize(void);
+
+/// Records the score of a finished game played at `difficulty`.
+void submit_score(const enum difficulty difficulty, const size_t score);
+
+/// Returns the `rank`-th best score for `difficulty`, starting from 0, or 0 if
+/// there is none.
+[[nodiscard]] size_t best_score(const enum difficulty difficulty,
+                                const unsigned rank);
+
+#endif // SCORE_H
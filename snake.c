@@ -6,14 +6,24 @@
 
 #include "snake.h"
 
-struct snake *snake_create(const struct point head, const size_t size) {
+/// Salt of the key of the cell where the head is, as opposed to body cells.
+#define HEAD_SALT 0xd1b54a32d192ed03ULL
+
+struct snake *snake_create(const uint32_t head, const size_t size,
+                           const int stride) {
   struct snake *snake = calloc(1, sizeof(struct snake));
-  snake->body = malloc(sizeof(struct point[size + 1]));
+  snake->body = malloc(sizeof(uint32_t[size + 1]));
   snake->body[0] = head;
   snake->head = head;
+  snake->old_tail = head;
+  snake->steps[UP] = -stride;
+  snake->steps[RIGHT] = 1;
+  snake->steps[DOWN] = stride;
+  snake->steps[LEFT] = -1;
   snake->length = 1;
   snake->growing = false;
   snake->direction = DOWN;
+  snake->hash = zobrist_key(head, 0) ^ zobrist_key(head, HEAD_SALT);
   return snake;
 }
 
@@ -29,8 +39,7 @@ void snake_destroy(struct snake *snake) {
 
 bool self_collision(const struct snake *snake) {
   for (size_t i = 0; i < snake->length - 1; ++i) {
-    if (snake->body[i].x == snake->head.x &&
-        snake->body[i].y == snake->head.y) {
+    if (snake->body[i] == snake->head) {
       return true;
     }
   }
@@ -39,30 +48,23 @@ bool self_collision(const struct snake *snake) {
 
 void advance(struct snake *snake) {
   snake->old_tail = snake->body[0];
+  snake->hash ^= zobrist_key(snake->head, HEAD_SALT);
 
   if (snake->growing) {
     snake->growing = false;
     snake->body[snake->length - 1] = snake->head;
-  } else if (snake->length > 1) {
-    memmove(snake->body, snake->body + 1,
-            sizeof(struct point[snake->length - 1]));
+  } else {
+    snake->hash ^= zobrist_key(snake->old_tail, 0);
+    if (snake->length > 1) {
+      memmove(snake->body, snake->body + 1,
+              sizeof(uint32_t[snake->length - 1]));
+    }
   }
 
-  switch (snake->direction) {
-  case UP:
-    --snake->head.y;
-    break;
-  case RIGHT:
-    ++snake->head.x;
-    break;
-  case DOWN:
-    ++snake->head.y;
-    break;
-  case LEFT:
-    --snake->head.x;
-    break;
-  }
+  snake->head += snake->steps[snake->direction];
   snake->body[snake->length - 1] = snake->head;
+  snake->hash ^=
+      zobrist_key(snake->head, 0) ^ zobrist_key(snake->head, HEAD_SALT);
 }
 
 void change_direction(struct snake *self, enum direction direction) {
@@ -73,3 +75,14 @@ void change_direction(struct snake *self, enum direction direction) {
     self->direction = direction;
   }
 }
+
+uint64_t zobrist_key(const uint32_t cell, const uint64_t salt) {
+  // Rather than a table of random numbers, the keys come from mixing the
+  // index of the cell with the splitmix64 finalizer, so they work for any map
+  // size.
+  uint64_t z = cell ^ salt;
+  z += 0x9e3779b97f4a7c15ULL;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
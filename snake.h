@@ -5,6 +5,7 @@
 #define SNAKE_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 enum direction { UP, RIGHT, DOWN, LEFT };
 
@@ -13,23 +14,35 @@ struct point {
   int x, y;
 };
 
+// The engine refers to a cell of the map by its index in the grid, row after
+// row, as a single `uint32_t`. Moving the head is an addition and comparing two
+// cells is an integer comparison. Coordinates are only needed to draw a cell,
+// see `cell_index` and `cell_point` in map.h.
+
 struct snake {
   /// The lengh of the snake is also the score of the game.
   size_t length;
   /// Previous tail position.
-  struct point old_tail;
+  uint32_t old_tail;
   /// Whether the snake is growing in the current game tick.
   bool growing;
   /// Direction in which the head of the snake is pointing.
   enum direction direction;
   /// Head of the snake. Equivanent to `body[length - 1]`.
-  struct point head;
-  /// Body of the snake, consisting of an array of points.
-  struct point *body;
+  uint32_t head;
+  /// Body of the snake, consisting of an array of cells.
+  uint32_t *body;
+  /// How the index of the head changes when it moves towards each direction.
+  int32_t steps[LEFT + 1];
+  /// Zobrist hash of the cells taken by the body and of the head position.
+  /// `advance` keeps it up to date without going through the whole body.
+  uint64_t hash;
 };
 
-/// Creates a new snake. This function allocats memory.
-[[nodiscard]] struct snake *snake_create(const struct point head, const size_t size);
+/// Creates a new snake on a grid with rows of `stride` cells. This function
+/// allocats memory.
+[[nodiscard]] struct snake *snake_create(const uint32_t head, const size_t size,
+                                         const int stride);
 
 /// Destroys a snake created with `snake_create`.
 void snake_destroy(struct snake *self);
@@ -43,4 +56,8 @@ void change_direction(struct snake *self, const enum direction direction);
 /// Checks whether the snake's head overlaps with any other point of its body.
 bool self_collision(const struct snake *self);
 
+/// Returns the Zobrist key of a cell, the salt distinguishes different kinds of
+/// keys for the same cell.
+[[nodiscard]] uint64_t zobrist_key(const uint32_t cell, const uint64_t salt);
+
 #endif // SNAKE_H
@@ -1,20 +1,183 @@
 // SPDX-License-Identifier: GPL-3.0-only
 // Copyright © 2024  Mario D'Andrea https://ormai.me
 
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
 #include <fcntl.h>
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/ioctl.h>
 #include <termios.h>
+#include <threads.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "term.h"
 
+/// Size of the ring buffer between the game and the render thread. It must be
+/// a power of two.
+#define RING_SIZE (1 << 16)
+
 static struct termios saved_attr;
+/// Colors of what is printed next. They reach the terminal only when something
+/// is printed with them, so setting a color and setting it back costs nothing.
+static enum color current_color = DEFAULT_COLOR,
+                  current_background = DEFAULT_COLOR;
+/// Colors the terminal is using, `-1` when they are not known.
+static int shown_color = -1, shown_background = -1;
+/// Whether reading the input waits for a key.
+static bool blocking_input = false;
+
+/// Output drawn since the last `refresh`. It also keeps whatever did not fit in
+/// the ring buffer, so that the game never waits for the terminal.
+static struct {
+  char *data;
+  size_t length, capacity;
+} frame;
+
+/// Lock-free single producer, single consumer ring buffer. Only the game
+/// thread moves `head` and only the render thread moves `tail`. Both grow
+/// forever and are reduced modulo `RING_SIZE` when indexing `data`.
+static struct {
+  char data[RING_SIZE];
+  _Atomic size_t head, tail;
+} ring;
+
+static thrd_t render_thread;
+static atomic_bool rendering;
+/// Whether the render thread stopped because the terminal cannot be written.
+/// From then on output is dropped, there is nobody to wait for.
+static atomic_bool broken;
+/// Only the render thread updates them, anyone can read them.
+static _Atomic uint64_t written_bytes, write_calls;
+
+/// Appends formatted output to the current frame.
+static void vemit(const char *fmt, va_list ap) {
+  if (frame.data == nullptr) {
+    frame.capacity = 4096;
+    frame.data = malloc(frame.capacity);
+  }
+  va_list copy;
+  va_copy(copy, ap);
+  const int n = vsnprintf(frame.data + frame.length,
+                          frame.capacity - frame.length, fmt, copy);
+  va_end(copy);
+  if (n < 0) {
+    return;
+  }
+  if (frame.length + n >= frame.capacity) {
+    while (frame.length + n >= frame.capacity) {
+      frame.capacity *= 2;
+    }
+    frame.data = realloc(frame.data, frame.capacity);
+    vsnprintf(frame.data + frame.length, frame.capacity - frame.length, fmt,
+              ap);
+  }
+  frame.length += n;
+}
+
+static void emit(const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  vemit(fmt, ap);
+  va_end(ap);
+}
+
+/// Writes everything that reaches the ring buffer to the terminal. All the
+/// frames queued while the previous write was in progress go out together.
+static int render(void *) {
+  while (true) {
+    const size_t tail = atomic_load_explicit(&ring.tail, memory_order_relaxed);
+    const size_t head = atomic_load_explicit(&ring.head, memory_order_acquire);
+    if (head == tail) {
+      if (!atomic_load(&rendering)) {
+        return 0;
+      }
+      nanosleep(&(struct timespec){0, 1'000'000}, nullptr);
+      continue;
+    }
+
+    // Up to the end of the buffer, the rest wraps around to the next write
+    const size_t begin = tail & (RING_SIZE - 1);
+    const size_t length =
+        head - tail < RING_SIZE - begin ? head - tail : RING_SIZE - begin;
+    const ssize_t written = write(STDOUT_FILENO, ring.data + begin, length);
+    atomic_fetch_add_explicit(&write_calls, 1, memory_order_relaxed);
+    if (written > 0) {
+      atomic_fetch_add_explicit(&written_bytes, written, memory_order_relaxed);
+      atomic_store_explicit(&ring.tail, tail + written, memory_order_release);
+    } else if (written == -1 && errno == EAGAIN) { // The terminal is full
+      nanosleep(&(struct timespec){0, 1'000'000}, nullptr);
+    } else if (written == 0 || errno != EINTR) {
+      atomic_store(&broken, true);
+      return 1;
+    }
+  }
+}
+
+void refresh(void) {
+  if (atomic_load(&broken)) {
+    frame.length = 0;
+    return;
+  }
+  const size_t head = atomic_load_explicit(&ring.head, memory_order_relaxed);
+  const size_t tail = atomic_load_explicit(&ring.tail, memory_order_acquire);
+  const size_t room = RING_SIZE - (head - tail);
+  const size_t length = frame.length < room ? frame.length : room;
+  if (length == 0) {
+    return;
+  }
+
+  const size_t begin = head & (RING_SIZE - 1);
+  const size_t first = length < RING_SIZE - begin ? length : RING_SIZE - begin;
+  memcpy(ring.data + begin, frame.data, first);
+  memcpy(ring.data, frame.data + first, length - first);
+  atomic_store_explicit(&ring.head, head + length, memory_order_release);
+
+  // Keep what did not fit for the next refresh
+  frame.length -= length;
+  memmove(frame.data, frame.data + length, frame.length);
+}
+
+/// Hands the whole frame to the render thread, waiting for room in the ring
+/// buffer if needed. `refresh` empties the frame if the render thread is gone.
+static void flush(void) {
+  refresh();
+  while (frame.length > 0) {
+    nanosleep(&(struct timespec){0, 1'000'000}, nullptr);
+    refresh();
+  }
+}
+
+void drain(void) {
+  flush();
+  while (atomic_load_explicit(&ring.tail, memory_order_acquire) !=
+             atomic_load_explicit(&ring.head, memory_order_relaxed) &&
+         !atomic_load(&broken)) {
+    nanosleep(&(struct timespec){0, 100'000}, nullptr);
+  }
+}
+
+struct term_stats get_term_stats(void) {
+  return (struct term_stats){atomic_load(&written_bytes),
+                             atomic_load(&write_calls)};
+}
 
 void term_init(void) {
+  current_color = current_background = DEFAULT_COLOR;
+  shown_color = shown_background = -1;
+  atomic_store(&written_bytes, 0);
+  atomic_store(&write_calls, 0);
+  atomic_store(&rendering, true);
+  atomic_store(&broken, false);
+  thrd_create(&render_thread, render, nullptr);
+
   // Switch to alternative screen, so that the previous terminal can be restored
-  printf(CSI "?1049h");
+  emit(CSI "?1049h");
 
   tcgetattr(STDIN_FILENO, &saved_attr);
   nonblocking_input(true);
@@ -24,16 +187,26 @@ void term_init(void) {
   t.c_lflag &= ~(ECHO | ICANON); // disable echo and canonical input mode
   tcsetattr(STDIN_FILENO, TCSANOW, &t);
 
-  printf(CSI "?25l"); // make cursor invisible
+  emit(CSI "?25l"); // make cursor invisible
 }
 
 void term_finalize(void) {
-  printf(CSI "?25h"); // make cursor visible
+  emit(CSI "?25h"); // make cursor visible
+  emit(CSI "?1049l"); // switch back from alternative screen
+  flush();
+  atomic_store(&rendering, false);
+  thrd_join(render_thread, nullptr);
   tcsetattr(STDIN_FILENO, TCSANOW, &saved_attr);
-  printf(CSI "?1049l"); // switch back from alternative screen
+
+  free(frame.data);
+  frame.data = nullptr;
+  frame.length = frame.capacity = 0;
 }
 
 int getch(void) {
+  if (blocking_input) { // Show everything before waiting for the user
+    flush();
+  }
   const int c = getchar();
   if (c == ESC) {
     getchar(); // skip [
@@ -49,6 +222,7 @@ struct winsize get_term_size(void) {
 }
 
 void nonblocking_input(const bool enabled) {
+  blocking_input = !enabled;
   if (enabled) {
     fcntl(STDIN_FILENO, F_SETFL, O_NONBLOCK);
   } else {
@@ -57,28 +231,55 @@ void nonblocking_input(const bool enabled) {
   }
 }
 
-void set_color(const enum color color) { printf(CSI "%dm", color); }
+void set_color(const enum color color) { current_color = color; }
 
-void erase(void) { printf(CSI "2J"); }
+enum color get_color(void) { return current_color; }
+
+void set_background(const enum color color) { current_background = color; }
+
+/// Tells the terminal the background color, the one used to erase.
+static void show_background(void) {
+  if (shown_background != (int)current_background) {
+    shown_background = current_background;
+    emit(CSI "%dm", current_background + 10); // The offset of a background
+  }
+}
+
+/// Tells the terminal both colors, in a single sequence if both changed.
+static void show_colors(void) {
+  if (shown_color == (int)current_color) {
+    show_background();
+  } else if (shown_background == (int)current_background) {
+    shown_color = current_color;
+    emit(CSI "%dm", current_color);
+  } else {
+    shown_color = current_color;
+    shown_background = current_background;
+    emit(CSI "%d;%dm", current_background + 10, current_color);
+  }
+}
+
+void erase(void) {
+  show_background();
+  emit(CSI "2J");
+}
 
 static inline void move(const int y, const int x) {
-  printf(CSI "%d;%dH", y + 1, x + 1);
+  emit(CSI "%d;%dH", y + 1, x + 1);
 }
 
 void erase_line(const int y) {
+  show_background();
   move(y, 0);
-  printf(CSI "2K");
+  emit(CSI "2K");
 }
 
 void print(const int y, const int x, const char *fmt, ...) {
+  show_colors();
   move(y, x);
 
-  char buf[2048];
   va_list ap;
   va_start(ap, fmt);
-  vsnprintf(buf, 2048, fmt, ap);
-  buf[2047] = '\0';
+  vemit(fmt, ap);
   va_end(ap);
-
-  printf("%s", buf);
 }
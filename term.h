@@ -11,6 +11,7 @@
 #ifndef TERM_H
 #define TERM_H
 
+#include <stdint.h>
 #include <sys/ioctl.h>
 
 #define ESC '\033'
@@ -37,6 +38,13 @@ enum color {
   BRIGHT_WHITE
 };
 
+/// What was sent to the terminal since `term_init`.
+struct term_stats {
+  uint64_t bytes;
+  /// Calls to `write`, each one a system call.
+  uint64_t writes;
+};
+
 enum arrow_key {
   ARROW_UP = '\033' + '[' + 'A',
   ARROW_DOWN,
@@ -50,6 +58,20 @@ void term_init(void);
 /// Restores the terminal behavior and its previous state.
 void term_finalize(void);
 
+/// Sends what was drawn since the last call to the terminal.
+///
+/// The output is written by a separate thread, so this never waits for the
+/// terminal. If the terminal falls behind, the output that does not fit in the
+/// queue is kept and sent along with the next call. Reading a key in blocking
+/// mode sends everything first.
+void refresh(void);
+
+/// Sends what was drawn so far to the terminal and waits until it is written.
+void drain(void);
+
+/// Returns what was sent to the terminal so far.
+[[nodiscard]] struct term_stats get_term_stats(void);
+
 /// Gets the current pressed key, if any.
 ///
 /// Terminals treat the arrow keys as escape sequences up: `^[[A`, down: `^[[B`,
@@ -66,9 +88,15 @@ void term_finalize(void);
 /// Toggles non blocking mode for standard input.
 void nonblocking_input(const bool enabled);
 
-/// Sets the foreground color for standard output.
+/// Sets the foreground color of what is printed next.
 void set_color(const enum color color);
 
+/// Returns the last foreground color set with `set_color`.
+[[nodiscard]] enum color get_color(void);
+
+/// Sets the background color of what is printed next, and of what is erased.
+void set_background(const enum color color);
+
 /// Erases everything on the terminal, like `clear` on the command line.
 void erase(void);
 
@@ -8,17 +8,64 @@
 #include <string.h>
 #include <time.h>
 
+#include "score.h"
 #include "snake.h"
 #include "term.h"
 #include "window.h"
 
-/// Translates an x coordinate to display on the map. Two cells represent one
-/// point: "██". Eg. x = 4 maps to the 9th actual terminal column.
-static int translate(const int x) { return x + x + 1; }
+/// Translates an x coordinate to display on the map. With `FULL_BLOCK` two
+/// cells represent one point: "██". Eg. x = 4 maps to the 9th actual terminal
+/// column. With `HALF_BLOCK` a point takes a single column.
+static int translate(const struct map *map, const int x) {
+  return map->mode == HALF_BLOCK ? x + 1 : x + x + 1;
+}
+
+/// Draws the terminal cell shared by the point at `position` and the one above
+/// or below it. The upper point is drawn with the foreground color of "▀" and
+/// the lower one with the background color, so both stay visible.
+static void draw_half_block(const struct map *map,
+                            const struct point position) {
+  const int top = position.y & ~1;
+  const enum color upper = map->colors[top][position.x],
+                   lower = map->colors[top + 1][position.x];
+  const int y = top / 2 + map->offset.y,
+            x = translate(map, position.x) + map->offset.x;
+
+  if (upper == DEFAULT_COLOR && lower == DEFAULT_COLOR) {
+    print(y, x, " ");
+  } else if (upper == DEFAULT_COLOR) {
+    set_color(lower);
+    print(y, x, "▄");
+  } else {
+    set_color(upper);
+    set_background(lower);
+    print(y, x, "▀");
+    set_background(DEFAULT_COLOR);
+  }
+}
+
+void draw_point(const struct map *map, const uint32_t cell) {
+  const struct point position = cell_point(map, cell);
+  if (map->mode == HALF_BLOCK) {
+    const enum color color = get_color();
+    map->colors[position.y][position.x] = color;
+    draw_half_block(map, position);
+    set_color(color);
+  } else {
+    print(position.y + map->offset.y,
+          translate(map, position.x) + map->offset.x, "██");
+  }
+}
 
-void draw_point(const struct map *map, const struct point position) {
-  print(position.y + map->offset.y, translate(position.x) + map->offset.x,
-        "██");
+void erase_point(const struct map *map, const uint32_t cell) {
+  const struct point position = cell_point(map, cell);
+  if (map->mode == HALF_BLOCK) {
+    map->colors[position.y][position.x] = DEFAULT_COLOR;
+    draw_half_block(map, position);
+  } else {
+    print(position.y + map->offset.y,
+          translate(map, position.x) + map->offset.x, "  ");
+  }
 }
 
 void update_score(const struct map *map, const size_t score) {
@@ -29,20 +76,48 @@ void update_score(const struct map *map, const size_t score) {
 void draw_walls(const struct map *map) {
   set_color(YELLOW);
   struct point up_left = {map->offset.x, map->offset.y - 1},
-               down_right = {translate(map->width) + map->offset.x + 2,
-                             map->height + map->offset.y + 1};
+               down_right = {map->offset.x + map->extent.x + 1,
+                             map->offset.y + map->extent.y};
+  // In half block mode with an odd number of rows, the border below the map is
+  // the lower half of the last terminal row
+  const bool half_row = map->mode == HALF_BLOCK && map->height % 2 == 0;
   for (int x = up_left.x; x <= down_right.x; ++x) {
     print(up_left.y, x, "▄");
-    print(down_right.y, x, "▀");
+    if (!half_row) {
+      print(down_right.y, x, "▀");
+    }
   }
   for (int y = up_left.y + 1; y < down_right.y; ++y) {
     print(y, up_left.x, "█");
     print(y, down_right.x, "█");
   }
+
+  // Obstacles inside the map
+  for (int y = 0; y <= map->height; ++y) {
+    const uint32_t row = cell_index(map, (struct point){0, y});
+    for (uint32_t cell = row; cell <= row + map->width; ++cell) {
+      if (map->grid[cell] == WALL) {
+        draw_point(map, cell);
+      }
+    }
+  }
+
+  if (half_row) {
+    for (int x = 0; x <= map->width; ++x) {
+      map->colors[map->height + 1][x] = YELLOW;
+      draw_half_block(map, (struct point){x, map->height});
+    }
+  }
 }
 
-void redraw_snake(const struct map *map, struct snake *snake) {
-  map->grid[snake->old_tail.y][snake->old_tail.x] = false;
+void redraw_snake(struct map *map, struct snake *snake) {
+  // A snake that grew kept its tail, and the head may have taken its place
+  if (snake->old_tail != snake->body[0]) {
+    set_cell(map, snake->old_tail, EMPTY);
+    if (snake->old_tail != snake->head) {
+      erase_point(map, snake->old_tail);
+    }
+  }
 
   if (snake->length > 1) {
     set_color(GREEN);
@@ -50,13 +125,20 @@ void redraw_snake(const struct map *map, struct snake *snake) {
   }
   set_color(BRIGHT_GREEN);
   draw_point(map, snake->head);
-  map->grid[snake->head.y][snake->head.x] = true;
-
-  print(snake->old_tail.y + map->offset.y,
-        translate(snake->old_tail.x) + map->offset.x, "  ");
+  set_cell(map, snake->head, BODY);
 }
 
-static inline void update_doodle(struct snake *doodle,
+/// The snake running around the welcome dialog. It moves on the terminal rather
+/// than on a map, so it keeps terminal coordinates.
+struct doodle {
+  size_t length;
+  struct point old_tail;
+  enum direction direction;
+  struct point head;
+  struct point body[8];
+};
+
+static inline void update_doodle(struct doodle *doodle,
                                  const struct point dialog_begin,
                                  const int dialog_height,
                                  const int dialog_width) {
@@ -104,6 +186,7 @@ static inline void update_doodle(struct snake *doodle,
     print(pre_head.y, pre_head.x, "██");
   }
   print(doodle->old_tail.y, doodle->old_tail.x, "  ");
+  refresh();
   nanosleep(&(struct timespec){0, 33'333'333}, nullptr);
 }
 
@@ -133,14 +216,15 @@ bool welcome_dialog(enum difficulty *difficulty) {
   const struct point begin = {ws.ws_col / 2 - width / 2 + 1,
                               ws.ws_row / 2 - height / 2 + 1};
 
-  struct snake *doodle = snake_create((struct point){begin.x, begin.y + 2}, 7);
-  doodle->direction = DOWN;
+  struct doodle doodle = {
+      .length = 1, .direction = DOWN, .head = {begin.x, begin.y + 2}};
+  doodle.body[0] = doodle.head;
   set_color(GREEN);
   for (int i = 0; i < 7; ++i) { // Make it long 7
-    doodle->head = doodle->body[doodle->length] =
-        (struct point){begin.x, doodle->head.y + 1};
-    ++doodle->length;
-    print(doodle->head.y, doodle->head.x, "██");
+    doodle.head = doodle.body[doodle.length] =
+        (struct point){begin.x, doodle.head.y + 1};
+    ++doodle.length;
+    print(doodle.head.y, doodle.head.x, "██");
   }
 
   set_color(DEFAULT_COLOR);
@@ -156,7 +240,6 @@ bool welcome_dialog(enum difficulty *difficulty) {
     switch (getch()) {
     case '\n':
     case 'y': {
-      snake_destroy(doodle);
       return false;
     }
     case '>':
@@ -177,23 +260,26 @@ bool welcome_dialog(enum difficulty *difficulty) {
       break;
     case 'n':
     case 'q':
-      snake_destroy(doodle);
       return true;
     }
-    update_doodle(doodle, begin, height, width);
+    update_doodle(&doodle, begin, height, width);
   }
 }
 
 static bool end_game_dialog(const struct map *map, enum difficulty *difficulty,
                             const size_t score, const char *banner[]) {
   static const int height = 16, width = 57;
-  const struct point begin = {map->offset.x + map->width - width / 2 + 1,
-                              map->offset.y + map->height / 2 - height / 2 + 1};
+  const struct point begin = {
+      map->offset.x + map->extent.x / 2 - width / 2,
+      map->offset.y + (map->extent.y - 1) / 2 - height / 2 + 1};
 
   set_color(DEFAULT_COLOR);
   for (int y = begin.y, i = 0; y < begin.y + height; ++y, ++i) {
     if (i == 9) { // Plug in the score
       print(y, begin.x, banner[i], score);
+    } else if (i == 10) { // Plug in the leaderboard
+      print(y, begin.x, banner[i], best_score(*difficulty, 0),
+            best_score(*difficulty, 1), best_score(*difficulty, 2));
     } else if (i == 11) { // Plug in the difficulty
       print(y, begin.x, banner[i], diff[*difficulty]);
     } else {
@@ -213,6 +299,8 @@ static bool end_game_dialog(const struct map *map, enum difficulty *difficulty,
       if (*difficulty != HARD) {
         ++*difficulty;
         set_color(DEFAULT_COLOR);
+        print(begin.y + 10, begin.x, banner[10], best_score(*difficulty, 0),
+              best_score(*difficulty, 1), best_score(*difficulty, 2));
         print(begin.y + 11, begin.x, banner[11], diff[*difficulty]);
       }
       break;
@@ -221,6 +309,8 @@ static bool end_game_dialog(const struct map *map, enum difficulty *difficulty,
       if (*difficulty != INCREMENTAL) {
         --*difficulty;
         set_color(DEFAULT_COLOR);
+        print(begin.y + 10, begin.x, banner[10], best_score(*difficulty, 0),
+              best_score(*difficulty, 1), best_score(*difficulty, 2));
         print(begin.y + 11, begin.x, banner[11], diff[*difficulty]);
       }
       break;
@@ -244,7 +334,7 @@ bool over_dialog(const struct map *map, enum difficulty *difficulty,
       "┃                                                       ┃",
       "┃                                                       ┃",
       "┃                   Your score was %-4d                 ┃",
-      "┃                                                       ┃",
+      "┃                Best %-5zu %-5zu %-5zu                 ┃",
       "┃               Difficulty %s              ┃",
       "┃                                                       ┃",
       "┃              Quit [q]      Play again [⏎]             ┃",
@@ -266,7 +356,7 @@ bool win_dialog(const struct map *map, enum difficulty *difficulty,
       "┃                                                       ┃",
       "┃                                                       ┃",
       "┃                   Your score was %-4d                 ┃",
-      "┃                                                       ┃",
+      "┃                Best %-5zu %-5zu %-5zu                 ┃",
       "┃               Difficulty: %s             ┃",
       "┃                                                       ┃",
       "┃              Quit [q]      Play again [⏎]             ┃",
@@ -22,17 +22,21 @@ enum difficulty {
   HARD
 };
 
-/// Draws a point consiting of "██" at position
-void draw_point(const struct map *map, const struct point position);
+/// Draws a cell of the map with the current color. Depending on the render
+/// mode of the map it consists of "██", or of half of "▀".
+void draw_point(const struct map *map, const uint32_t cell);
+
+/// Erases a cell of the map.
+void erase_point(const struct map *map, const uint32_t cell);
 
 /// Redraws the score line on the screen with the updated value.
 void update_score(const struct map *map, const size_t score);
 
-/// Draws the four walls delimiting the map.
+/// Draws the four walls delimiting the map and the obstacles inside it.
 void draw_walls(const struct map *map);
 
 /// Draws the snake on the screen after it has advanced.
-void redraw_snake(const struct map *map, struct snake *snake);
+void redraw_snake(struct map *map, struct snake *snake);
 
 /// Shows the welcome dialog. Returns `true` if the user wants to quit.
 bool welcome_dialog(enum difficulty *difficulty);